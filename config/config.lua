@@ -226,11 +226,12 @@ local function is_focused_display(displayName)
 end
 
 return {
-    buffers = {
-        num = 1,
-        width = 2000,
-        height = 1000,
-    },
+    -- Keep panels rendered while hidden, shows faster but keeps buffers in memory
+    prerender = false,
+    -- Draw all panels of an output in one buffer, uses less memory with many panels
+    atlas = false,
+    -- Fonts loaded at startup, the first show would otherwise wait for them
+    fonts = { "digital-7 40" },
     panels = {
         {
             anchor = "left",
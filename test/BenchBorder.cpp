@@ -0,0 +1,73 @@
+#include <benchmark/benchmark.h>
+#include <cairo.h>
+
+#include <cmath>
+
+// Box borders drawn the way boxes were drawn before borders were filled as one path, with a
+// stroke into an offscreen group used as mask, and the way DrawBox draws them now.
+
+static void BeginRectangleSubPath(cairo_t* cr, int x, int y, int cx, int cy, int radius) {
+    constexpr double degrees = M_PI / 180.0;
+    cairo_new_sub_path(cr);
+    cairo_arc(cr, x + cx - radius, y + radius, radius, -90 * degrees, 0 * degrees);
+    cairo_arc(cr, x + cx - radius, y + cy - radius, radius, 0 * degrees, 90 * degrees);
+    cairo_arc(cr, x + radius, y + cy - radius, radius, 90 * degrees, 180 * degrees);
+    cairo_arc(cr, x + radius, y + radius, radius, 180 * degrees, 270 * degrees);
+    cairo_close_path(cr);
+}
+
+static void DrawGroupMaskBorder(cairo_t* cr, int cx, int cy, int width, int radius) {
+    BeginRectangleSubPath(cr, width, width, cx - (2 * width), cy - (2 * width), radius);
+    cairo_push_group_with_content(cr, CAIRO_CONTENT_ALPHA);
+    cairo_set_line_width(cr, width * 2.0);
+    cairo_set_source_rgba(cr, 0, 0, 0, 1);
+    cairo_set_operator(cr, CAIRO_OPERATOR_SOURCE);
+    cairo_stroke_preserve(cr);
+    cairo_set_operator(cr, CAIRO_OPERATOR_CLEAR);
+    cairo_fill_preserve(cr);
+    auto mask = cairo_pop_group(cr);
+    cairo_set_source_rgba(cr, 0.5, 0.5, 0.5, 1);
+    cairo_mask(cr, mask);
+    cairo_pattern_destroy(mask);
+    // Fill
+    cairo_set_source_rgba(cr, 0.1, 0.1, 0.1, 1);
+    cairo_fill(cr);
+}
+
+static void DrawEvenOddBorder(cairo_t* cr, int cx, int cy, int width, int radius) {
+    const int innerCx = cx - (2 * width);
+    const int innerCy = cy - (2 * width);
+    BeginRectangleSubPath(cr, 0, 0, cx, cy, radius ? radius + width : 0);
+    BeginRectangleSubPath(cr, width, width, innerCx, innerCy, radius);
+    cairo_set_fill_rule(cr, CAIRO_FILL_RULE_EVEN_ODD);
+    cairo_set_source_rgba(cr, 0.5, 0.5, 0.5, 1);
+    cairo_fill(cr);
+    cairo_set_fill_rule(cr, CAIRO_FILL_RULE_WINDING);
+    // Fill
+    BeginRectangleSubPath(cr, width, width, innerCx, innerCy, radius);
+    cairo_set_source_rgba(cr, 0.1, 0.1, 0.1, 1);
+    cairo_fill(cr);
+}
+
+// Arguments are width, height, border width and radius of the box
+template <auto draw>
+static void BM_Border(benchmark::State& state) {
+    const int cx = state.range(0), cy = state.range(1);
+    auto surface = cairo_image_surface_create(CAIRO_FORMAT_ARGB32, cx, cy);
+    auto cr = cairo_create(surface);
+    for (auto _ : state) {
+        draw(cr, cx, cy, state.range(2), state.range(3));
+    }
+    cairo_surface_flush(surface);
+    cairo_destroy(cr);
+    cairo_surface_destroy(surface);
+}
+
+static void BoxArgs(benchmark::internal::Benchmark* b) {
+    b->Args({120, 40, 2, 5})->Args({120, 40, 2, 0})->Args({400, 60, 4, 10});
+}
+
+BENCHMARK(BM_Border<DrawGroupMaskBorder>)->Name("BM_GroupMaskBorder")->Apply(BoxArgs);
+BENCHMARK(BM_Border<DrawEvenOddBorder>)->Name("BM_EvenOddBorder")->Apply(BoxArgs);
+
+BENCHMARK_MAIN();
@@ -0,0 +1,53 @@
+#include <benchmark/benchmark.h>
+#include <pango/pangocairo.h>
+
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "zen/FontWarmup.h"
+
+// Time of the first layout drawn on a new thread, like the first raster of a panel on a worker
+// thread when shown for the first time, with and without the fonts warmed on that thread.
+// Fontconfig is loaded once for the process before, as done by the warmup at startup.
+
+static const std::vector<std::string> fonts = {"Sans 15", "Monospace 12"};
+
+static const char* markup =
+    "<span font='Sans 15'>Volume 42%</span> <span font='Monospace 12'>12:34</span>";
+
+static std::chrono::nanoseconds FirstLayout() {
+    auto surface = cairo_image_surface_create(CAIRO_FORMAT_ARGB32, 400, 40);
+    auto cr = cairo_create(surface);
+    const auto start = std::chrono::steady_clock::now();
+    auto layout = pango_cairo_create_layout(cr);
+    pango_layout_set_markup(layout, markup, -1);
+    pango_layout_get_pixel_extents(layout, nullptr, nullptr);
+    pango_cairo_show_layout(cr, layout);
+    const auto elapsed = std::chrono::steady_clock::now() - start;
+    g_object_unref(layout);
+    cairo_destroy(cr);
+    cairo_surface_destroy(surface);
+    return elapsed;
+}
+
+// Argument is 1 when the thread warms the fonts before the first layout
+static void BM_FirstLayoutOnNewThread(benchmark::State& state) {
+    FontWarmup::WarmThread(fonts);
+    const bool warm = state.range(0);
+    for (auto _ : state) {
+        std::chrono::nanoseconds elapsed;
+        // Every thread has its own default font map
+        std::thread thread([&elapsed, warm] {
+            if (warm) FontWarmup::WarmThread(fonts);
+            elapsed = FirstLayout();
+        });
+        thread.join();
+        state.SetIterationTime(std::chrono::duration<double>(elapsed).count());
+    }
+}
+
+BENCHMARK(BM_FirstLayoutOnNewThread)->Arg(0)->Arg(1)->UseManualTime();
+
+BENCHMARK_MAIN();
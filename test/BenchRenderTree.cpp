@@ -0,0 +1,133 @@
+#include <benchmark/benchmark.h>
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "zen/RenderTree.h"
+
+// Builds and hashes a widget the way it is done on every render: a flex row of boxes with
+// markup and tags. The pointer tree is the tree of virtual renderables that render trees
+// replaced, reduced to what is used when building and hashing.
+
+namespace pointer {
+
+static size_t HashPadding(const Padding& padding) {
+    size_t hash = 0;
+    HashCombine(hash, padding.left);
+    HashCombine(hash, padding.right);
+    HashCombine(hash, padding.top);
+    HashCombine(hash, padding.bottom);
+    return hash;
+}
+
+static size_t HashColor(const RGBA& color) {
+    size_t hash = 0;
+    HashCombine(hash, std::hash<double>{}(color.r));
+    HashCombine(hash, std::hash<double>{}(color.g));
+    HashCombine(hash, std::hash<double>{}(color.b));
+    HashCombine(hash, std::hash<double>{}(color.a));
+    return hash;
+}
+
+struct Renderable {
+    Renderable() : computed{} {}
+    virtual ~Renderable() {}
+    virtual size_t Hash() const { return 0; }
+    Size computed;
+};
+
+struct Markup : public Renderable {
+    Markup(const std::string& string) : string(string) {}
+    size_t Hash() const override { return std::hash<std::string>{}(string); }
+    const std::string string;
+};
+
+struct MarkupBox : public Renderable {
+    MarkupBox(const std::string& string)
+        : markup(string), color{}, border{}, radius(0), padding{} {}
+    size_t Hash() const override {
+        auto hash = markup.Hash();
+        HashCombine(hash, HashColor(color));
+        HashCombine(hash, HashColor(border.color));
+        HashCombine(hash, border.width);
+        HashCombine(hash, radius);
+        HashCombine(hash, HashPadding(padding));
+        HashCombine(hash, std::hash<std::string>{}(tag));
+        return hash;
+    }
+    Markup markup;
+    RGBA color;
+    Border border;
+    uint8_t radius;
+    Padding padding;
+    std::string tag;
+};
+
+struct FlexContainer : public Renderable {
+    FlexContainer() : isColumn(false), padding{} {}
+    size_t Hash() const override {
+        size_t hash = isColumn;
+        HashCombine(hash, HashPadding(padding));
+        HashCombine(hash, std::hash<std::string>{}(tag));
+        for (const auto& child : children) {
+            HashCombine(hash, child->Hash());
+        }
+        return hash;
+    }
+    bool isColumn;
+    Padding padding;
+    std::vector<std::unique_ptr<Renderable>> children;
+    std::string tag;
+};
+
+}  // namespace pointer
+
+static std::vector<std::string> Markups(int n) {
+    std::vector<std::string> markups;
+    for (int i = 0; i < n; i++) {
+        markups.push_back("<span size='15pt' color='#1c1b19'>Item " + std::to_string(i) +
+                          " 42%</span>");
+    }
+    return markups;
+}
+
+static void BM_PointerTree(benchmark::State& state) {
+    const auto markups = Markups(state.range(0));
+    for (auto _ : state) {
+        auto flex = std::make_unique<pointer::FlexContainer>();
+        for (const auto& markup : markups) {
+            auto box = std::make_unique<pointer::MarkupBox>(markup);
+            box->border.width = 2;
+            box->tag = "tag";
+            flex->children.push_back(std::move(box));
+        }
+        benchmark::DoNotOptimize(flex->Hash());
+    }
+}
+
+static void BM_FlatTree(benchmark::State& state) {
+    const auto markups = Markups(state.range(0));
+    // Kept between renders like the tree of a widget
+    RenderTree tree;
+    for (auto _ : state) {
+        tree.Clear();
+        const auto root = tree.Add(NodeType::Flex);
+        const auto first = tree.AddChildren(root, markups.size());
+        for (size_t i = 0; i < markups.size(); i++) {
+            auto& box = tree.At(first + i);
+            box.type = NodeType::Box;
+            box.markup = tree.AddText(markups[i]);
+            box.tag = tree.AddText("tag");
+            box.border.width = 2;
+        }
+        tree.HashNodes();
+        benchmark::DoNotOptimize(tree.Hash());
+    }
+}
+
+BENCHMARK(BM_PointerTree)->Arg(4)->Arg(16)->Arg(64);
+BENCHMARK(BM_FlatTree)->Arg(4)->Arg(16)->Arg(64);
+
+BENCHMARK_MAIN();
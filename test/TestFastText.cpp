@@ -0,0 +1,180 @@
+#include <catch2/catch_session.hpp>
+#include <catch2/catch_test_macros.hpp>
+#include <cstdint>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "pango/pangocairo.h"
+#include "zen/BlendMask.h"
+#include "zen/FastText.h"
+
+TEST_CASE("Plain text and spans are parsed into runs", "[fasttext]") {
+    std::vector<FastText::Run> runs;
+    REQUIRE(FastText::Parse("Volume 42%", runs));
+    REQUIRE(runs.size() == 1);
+    CHECK(runs[0].text == "Volume 42%");
+    CHECK(runs[0].attributes.font.empty());
+
+    REQUIRE(FastText::Parse("<span font='Sans 15' color='#ff0000'>a</span>"
+                            "<span size=\"10pt\" rise='-2048'>b &amp; c</span>d",
+                            runs));
+    REQUIRE(runs.size() == 3);
+    CHECK(runs[0].text == "a");
+    CHECK(runs[0].attributes.font == "Sans 15");
+    CHECK(runs[0].attributes.hasColor);
+    CHECK(runs[0].attributes.color.r == 1);
+    CHECK(runs[1].text == "b & c");
+    CHECK(runs[1].attributes.size == 10 * PANGO_SCALE);
+    CHECK(runs[1].attributes.rise == -2048);
+    CHECK_FALSE(runs[1].attributes.hasColor);
+    CHECK(runs[2].text == "d");
+    CHECK(runs[2].attributes.size == 0);
+}
+
+TEST_CASE("Nested spans inherit attributes", "[fasttext]") {
+    std::vector<FastText::Run> runs;
+    REQUIRE(FastText::Parse("<span face='Mono'><span size='12pt'>a</span>b</span>", runs));
+    REQUIRE(runs.size() == 2);
+    CHECK(runs[0].attributes.family == "Mono");
+    CHECK(runs[0].attributes.size == 12 * PANGO_SCALE);
+    CHECK(runs[1].attributes.family == "Mono");
+    CHECK(runs[1].attributes.size == 0);
+}
+
+TEST_CASE("Markup that needs Pango is rejected", "[fasttext]") {
+    std::vector<FastText::Run> runs;
+    // Unsupported attributes and values
+    CHECK_FALSE(FastText::Parse("<span weight='bold'>a</span>", runs));
+    CHECK_FALSE(FastText::Parse("<span size='large'>a</span>", runs));
+    CHECK_FALSE(FastText::Parse("<span color='red'>a</span>", runs));
+    CHECK_FALSE(FastText::Parse("<span size='-10pt'>a</span>", runs));
+    // Other tags and entities
+    CHECK_FALSE(FastText::Parse("<b>a</b>", runs));
+    CHECK_FALSE(FastText::Parse("<spanx>a</spanx>", runs));
+    CHECK_FALSE(FastText::Parse("&nbsp;", runs));
+    CHECK_FALSE(FastText::Parse("&#233;", runs));
+    // Malformed
+    CHECK_FALSE(FastText::Parse("<span font='Sans'>a", runs));
+    CHECK_FALSE(FastText::Parse("a</span>", runs));
+    CHECK_FALSE(FastText::Parse("<span font=Sans>a</span>", runs));
+    CHECK_FALSE(FastText::Parse("a &amp b", runs));
+    // Nothing to draw
+    CHECK_FALSE(FastText::Parse("", runs));
+    CHECK_FALSE(FastText::Parse("<span font='Sans'></span>", runs));
+}
+
+TEST_CASE("Blending is the same four pixels at a time as one by one", "[fasttext]") {
+    std::mt19937 random(42);
+    auto byte = [&random]() { return (uint8_t)(random() & 0xff); };
+    // Widths that leave every possible scalar tail
+    for (int cx = 1; cx <= 11; cx++) {
+        const int cy = 3, stride = 12 * 4, maskStride = 16;
+        std::vector<uint8_t> mask(maskStride * cy);
+        for (auto& m : mask) {
+            // Zero and full coverage are special cased
+            const auto r = byte();
+            m = r < 64 ? 0 : r < 128 ? 255 : r;
+        }
+        for (int i = 0; i < 32; i++) {
+            // Premultiplied, no channel above alpha
+            uint8_t color[4];
+            color[3] = i == 0 ? 255 : byte();
+            for (int c = 0; c < 3; c++) color[c] = color[3] ? byte() % (color[3] + 1) : 0;
+            std::vector<uint8_t> pixels(stride * cy);
+            for (size_t p = 0; p < pixels.size(); p += 4) {
+                pixels[p + 3] = byte();
+                for (int c = 0; c < 3; c++) pixels[p + c] = byte() % (pixels[p + 3] + 1);
+            }
+            auto scalar = pixels;
+            BlendMaskScalar(scalar.data(), stride, mask.data(), maskStride, cx, cy, color);
+            BlendMask(pixels.data(), stride, mask.data(), maskStride, cx, cy, color);
+            INFO("width " << cx << ", color " << i);
+            REQUIRE(pixels == scalar);
+        }
+    }
+}
+
+// Measured like the render tree does when the markup is drawn with Pango
+static Size PangoSize(cairo_t* cr, const char* markup) {
+    auto layout = pango_cairo_create_layout(cr);
+    pango_layout_set_markup(layout, markup, -1);
+    PangoRectangle rect;
+    pango_layout_get_extents(layout, nullptr, &rect);
+    pango_extents_to_pixels(&rect, nullptr);
+    g_object_unref(layout);
+    return Size{rect.width, rect.height};
+}
+
+struct Surface {
+    cairo_surface_t* surface;
+    cairo_t* cr;
+
+    Surface()
+        : surface(cairo_image_surface_create(CAIRO_FORMAT_ARGB32, 400, 100)),
+          cr(cairo_create(surface)) {}
+    ~Surface() {
+        cairo_destroy(cr);
+        cairo_surface_destroy(surface);
+    }
+};
+
+TEST_CASE("Fast text has the same extents as Pango", "[fasttext]") {
+    Surface surface;
+    auto fastText = FastText::Create();
+    REQUIRE(fastText);
+    const char* markups[] = {
+        "Volume 42%",
+        "<span font='Sans 15'>12:34</span>",
+        "<span font='Monospace 12'>CPU</span> <span font='Sans 20'>87%</span>",
+        "<span font='Sans 10' rise='4096'>up</span>down",
+        "<span font='Sans 10' rise='-3072'>down</span>up",
+        "two\nlines",
+    };
+    for (auto markup : markups) {
+        INFO(markup);
+        auto text = fastText->Get(surface.cr, markup);
+        REQUIRE(text);
+        const auto expected = PangoSize(surface.cr, markup);
+        CHECK(text->size.cx == expected.cx);
+        CHECK(text->size.cy == expected.cy);
+    }
+}
+
+TEST_CASE("Markup that needs Pango falls back", "[fasttext]") {
+    Surface surface;
+    auto fastText = FastText::Create();
+    REQUIRE(fastText);
+    CHECK(fastText->Get(surface.cr, "<span weight='bold'>a</span>") == nullptr);
+    CHECK(fastText->GetStats().fallbacks == 1);
+    // Remembered without parsing again
+    CHECK(fastText->Get(surface.cr, "<span weight='bold'>a</span>") == nullptr);
+    CHECK(fastText->GetStats().misses == 1);
+    CHECK(fastText->GetStats().fallbacks == 2);
+    // Needs itemization
+    CHECK(fastText->Get(surface.cr, "שלום") == nullptr);
+    CHECK(fastText->GetStats().fallbacks == 3);
+}
+
+TEST_CASE("Least recently used texts are evicted", "[fasttext]") {
+    Surface surface;
+    auto fastText = FastText::Create();
+    REQUIRE(fastText);
+    // Unsupported markup is cached without shaping
+    auto markup = [](int i) { return "<span weight='bold'>" + std::to_string(i) + "</span>"; };
+    fastText->Get(surface.cr, markup(0));
+    for (int i = 1; i < 1000; i++) {
+        fastText->Get(surface.cr, markup(i));
+        // Keeps the first one in use
+        fastText->Get(surface.cr, markup(0));
+    }
+    const auto& stats = fastText->GetStats();
+    CHECK(stats.evictions > 0);
+    CHECK(stats.misses == 1000);
+    fastText->Get(surface.cr, markup(0));
+    CHECK(stats.misses == 1000);
+    fastText->Get(surface.cr, markup(1));
+    CHECK(stats.misses == 1001);
+}
+
+int main(int argc, char* argv[]) { return Catch::Session().run(argc, argv); }
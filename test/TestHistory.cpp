@@ -0,0 +1,52 @@
+#include <catch2/catch_session.hpp>
+#include <catch2/catch_test_macros.hpp>
+#include <vector>
+
+#include "zen/History.h"
+
+static std::vector<float> Values(const History& history) {
+    std::vector<float> values;
+    history.Values(values);
+    return values;
+}
+
+TEST_CASE("Nothing is sampled before a value is set", "[history]") {
+    History history(4);
+    history.Sample();
+    history.Sample();
+    CHECK(history.NumSamples() == 0);
+    CHECK(Values(history).empty());
+}
+
+TEST_CASE("Every sample takes the current value", "[history]") {
+    History history(4);
+    history.Set(1);
+    history.Sample();
+    // Unchanged value is sampled again, only the last change before a sample is kept
+    history.Sample();
+    history.Set(2);
+    history.Set(3);
+    history.Sample();
+    CHECK(Values(history) == std::vector<float>{1, 1, 3});
+}
+
+TEST_CASE("Oldest samples are dropped at capacity", "[history]") {
+    History history(3);
+    for (int i = 1; i <= 5; i++) {
+        history.Set(i);
+        history.Sample();
+    }
+    CHECK(history.NumSamples() == 3);
+    CHECK(Values(history) == std::vector<float>{3, 4, 5});
+}
+
+TEST_CASE("Values are appended", "[history]") {
+    History history(2);
+    history.Set(7);
+    history.Sample();
+    std::vector<float> values{1};
+    history.Values(values);
+    CHECK(values == std::vector<float>{1, 7});
+}
+
+int main(int argc, char* argv[]) { return Catch::Session().run(argc, argv); }
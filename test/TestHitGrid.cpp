@@ -0,0 +1,136 @@
+#include <catch2/catch_session.hpp>
+#include <catch2/catch_test_macros.hpp>
+#include <vector>
+
+#include "zen/HitGrid.h"
+
+static DrawnPanel Panel(Size size, std::vector<DrawnWidget> widgets) {
+    DrawnPanel drawn;
+    drawn.size = size;
+    drawn.widgets = std::move(widgets);
+    return drawn;
+}
+
+// What the grid replaced, testing every widget and target one by one
+static bool FindLinear(const DrawnPanel& drawn, int x, int y, size_t& widget, int& target) {
+    for (size_t i = 0; i < drawn.widgets.size(); i++) {
+        const auto& w = drawn.widgets[i];
+        if (!w.position.Contains(x, y)) continue;
+        widget = i;
+        target = -1;
+        for (size_t t = 0; t < w.targets.size(); t++) {
+            if (w.targets[t].position.Contains(x, y)) {
+                target = t;
+                break;
+            }
+        }
+        return true;
+    }
+    return false;
+}
+
+TEST_CASE("Nothing is found in empty grid", "[hitgrid]") {
+    HitGrid grid;
+    size_t widget;
+    int target;
+    CHECK_FALSE(grid.Find(0, 0, widget, target));
+    grid.Build(Panel({100, 40}, {}));
+    CHECK_FALSE(grid.Find(10, 10, widget, target));
+}
+
+TEST_CASE("Widget is found inside and not outside", "[hitgrid]") {
+    HitGrid grid;
+    grid.Build(Panel({100, 40}, {{.position = {10, 5, 20, 10}, .targets = {}}}));
+    size_t widget = 99;
+    int target = 99;
+    REQUIRE(grid.Find(15, 10, widget, target));
+    CHECK(widget == 0);
+    CHECK(target == -1);
+    CHECK_FALSE(grid.Find(5, 10, widget, target));
+    CHECK_FALSE(grid.Find(15, 20, widget, target));
+    CHECK_FALSE(grid.Find(-1, 10, widget, target));
+    CHECK_FALSE(grid.Find(15, -1, widget, target));
+    CHECK_FALSE(grid.Find(500, 10, widget, target));
+}
+
+TEST_CASE("Right and bottom edge on a cell border are found", "[hitgrid]") {
+    HitGrid grid;
+    // Edges at 32 and 64 are the first column and row of the next cell
+    grid.Build(Panel({100, 70}, {{.position = {0, 0, 32, 32}, .targets = {}},
+                                 {.position = {40, 40, 24, 24}, .targets = {}}}));
+    size_t widget;
+    int target;
+    REQUIRE(grid.Find(32, 10, widget, target));
+    CHECK(widget == 0);
+    REQUIRE(grid.Find(10, 32, widget, target));
+    CHECK(widget == 0);
+    REQUIRE(grid.Find(32, 32, widget, target));
+    CHECK(widget == 0);
+    REQUIRE(grid.Find(64, 64, widget, target));
+    CHECK(widget == 1);
+    REQUIRE(grid.Find(40, 40, widget, target));
+    CHECK(widget == 1);
+    CHECK_FALSE(grid.Find(65, 64, widget, target));
+}
+
+TEST_CASE("Target of widget is found", "[hitgrid]") {
+    HitGrid grid;
+    grid.Build(Panel({100, 40}, {{.position = {0, 0, 100, 40},
+                                  .targets = {{.position = {10, 0, 10, 40}, .tag = "a"},
+                                              {.position = {60, 0, 30, 40}, .tag = "b"}}}}));
+    size_t widget;
+    int target;
+    REQUIRE(grid.Find(15, 20, widget, target));
+    CHECK(target == 0);
+    REQUIRE(grid.Find(70, 20, widget, target));
+    CHECK(target == 1);
+    REQUIRE(grid.Find(40, 20, widget, target));
+    CHECK(target == -1);
+}
+
+TEST_CASE("Overlapping widgets are found in drawn order", "[hitgrid]") {
+    HitGrid grid;
+    grid.Build(Panel({100, 40}, {{.position = {0, 0, 50, 40}, .targets = {}},
+                                 {.position = {20, 0, 60, 40},
+                                  .targets = {{.position = {20, 0, 60, 40}, .tag = "t"}}}}));
+    size_t widget;
+    int target;
+    REQUIRE(grid.Find(30, 20, widget, target));
+    CHECK(widget == 0);
+    CHECK(target == -1);
+    REQUIRE(grid.Find(60, 20, widget, target));
+    CHECK(widget == 1);
+    CHECK(target == 0);
+}
+
+TEST_CASE("Grid finds the same as testing one by one", "[hitgrid]") {
+    const auto drawn =
+        Panel({200, 90}, {{.position = {0, 0, 64, 30},
+                           .targets = {{.position = {0, 0, 32, 30}, .tag = "a"},
+                                       {.position = {16, 0, 48, 30}, .tag = "b"}}},
+                          {.position = {50, 20, 100, 50},
+                           .targets = {{.position = {96, 32, 10, 10}, .tag = "c"}}},
+                          {.position = {0, 0, 200, 90}, .targets = {}},
+                          // Partly outside of the panel
+                          {.position = {180, 70, 64, 64},
+                           .targets = {{.position = {190, 80, 40, 40}, .tag = "d"}}}});
+    HitGrid grid;
+    grid.Build(drawn);
+    // Including the right and bottom edge of the panel
+    for (int y = 0; y <= drawn.size.cy; y++) {
+        for (int x = 0; x <= drawn.size.cx; x++) {
+            size_t expectedWidget = 0, widget = 0;
+            int expectedTarget = -1, target = -1;
+            const bool expected = FindLinear(drawn, x, y, expectedWidget, expectedTarget);
+            const bool found = grid.Find(x, y, widget, target);
+            INFO("at " << x << "," << y);
+            REQUIRE(found == expected);
+            if (found) {
+                CHECK(widget == expectedWidget);
+                CHECK(target == expectedTarget);
+            }
+        }
+    }
+}
+
+int main(int argc, char* argv[]) { return Catch::Session().run(argc, argv); }
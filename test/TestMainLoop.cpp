@@ -0,0 +1,90 @@
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#include <catch2/catch_session.hpp>
+#include <catch2/catch_test_macros.hpp>
+#include <functional>
+#include <memory>
+
+#include "zen/MainLoop.h"
+
+// Reads its eventfd and calls back, the callback is free to change the registrations
+class EventHandler : public IoHandler {
+   public:
+    EventHandler() : fd(eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)), numReads(0) {}
+    ~EventHandler() { close(fd); }
+    bool OnRead() override {
+        uint64_t ignore;
+        read(fd, &ignore, sizeof(ignore));
+        numReads++;
+        if (onRead) onRead();
+        return false;
+    }
+    void Signal() {
+        uint64_t inc = 1;
+        write(fd, &inc, sizeof(inc));
+    }
+    const int fd;
+    int numReads;
+    std::function<void()> onRead;
+};
+
+TEST_CASE("Handler is invoked when its fd is readable", "[mainloop]") {
+    auto mainLoop = MainLoop::Create();
+    REQUIRE(mainLoop);
+    auto handler = std::make_shared<EventHandler>();
+    REQUIRE(mainLoop->RegisterIoHandler(handler->fd, "handler", handler));
+    CHECK_FALSE(mainLoop->RegisterIoHandler(handler->fd, "again", handler));
+    handler->Signal();
+    REQUIRE(mainLoop->Dispatch());
+    CHECK(handler->numReads == 1);
+}
+
+TEST_CASE("Handler unregistered by another handler in the same batch is not invoked",
+          "[mainloop]") {
+    auto mainLoop = MainLoop::Create();
+    REQUIRE(mainLoop);
+    auto a = std::make_shared<EventHandler>();
+    auto b = std::make_shared<EventHandler>();
+    // Whichever is invoked first unregisters the other
+    a->onRead = [&] { mainLoop->UnregisterIoHandler(b->fd); };
+    b->onRead = [&] { mainLoop->UnregisterIoHandler(a->fd); };
+    REQUIRE(mainLoop->RegisterIoHandler(a->fd, "a", a));
+    REQUIRE(mainLoop->RegisterIoHandler(b->fd, "b", b));
+    a->Signal();
+    b->Signal();
+    REQUIRE(mainLoop->Dispatch());
+    REQUIRE(a->numReads + b->numReads == 1);
+    const auto& invoked = a->numReads == 1 ? a : b;
+    const auto& unregistered = a->numReads == 1 ? b : a;
+    // Main loop lets go of the unregistered handler when the batch is done
+    CHECK(invoked.use_count() == 2);
+    CHECK(unregistered.use_count() == 1);
+    // Fd of the unregistered handler is still readable but only the wakeup is handled
+    mainLoop->Wakeup();
+    REQUIRE(mainLoop->Dispatch());
+    CHECK(unregistered->numReads == 0);
+}
+
+TEST_CASE("Handler can unregister itself and register another", "[mainloop]") {
+    auto mainLoop = MainLoop::Create();
+    REQUIRE(mainLoop);
+    auto first = std::make_shared<EventHandler>();
+    auto second = std::make_shared<EventHandler>();
+    first->onRead = [&] {
+        mainLoop->UnregisterIoHandler(first->fd);
+        mainLoop->RegisterIoHandler(second->fd, "second", second);
+    };
+    REQUIRE(mainLoop->RegisterIoHandler(first->fd, "first", first));
+    first->Signal();
+    REQUIRE(mainLoop->Dispatch());
+    CHECK(first->numReads == 1);
+    // Only the handler registered from the callback is invoked
+    first->Signal();
+    second->Signal();
+    REQUIRE(mainLoop->Dispatch());
+    CHECK(first->numReads == 1);
+    CHECK(second->numReads == 1);
+}
+
+int main(int argc, char* argv[]) { return Catch::Session().run(argc, argv); }
@@ -0,0 +1,94 @@
+#include <catch2/catch_session.hpp>
+#include <catch2/catch_test_macros.hpp>
+#include <vector>
+
+#include "zen/Packing.h"
+
+static bool Overlaps(const Rect& a, const Rect& b) {
+    return a.x < b.x + b.cx && b.x < a.x + a.cx && a.y < b.y + b.cy && b.y < a.y + a.cy;
+}
+
+TEST_CASE("Nothing packed is a single pixel", "[packing]") {
+    std::vector<Rect> packing;
+    const auto packed = PackShelves({}, packing);
+    CHECK(packed.cx == 1);
+    CHECK(packed.cy == 1);
+    CHECK(packing.empty());
+}
+
+TEST_CASE("Single size is placed at origin", "[packing]") {
+    std::vector<Rect> packing;
+    const auto packed = PackShelves({{30, 10}}, packing);
+    CHECK(packed.cx == 30);
+    CHECK(packed.cy == 10);
+    REQUIRE(packing.size() == 1);
+    CHECK(packing[0].x == 0);
+    CHECK(packing[0].y == 0);
+}
+
+TEST_CASE("Zero size takes a pixel", "[packing]") {
+    std::vector<Rect> packing;
+    PackShelves({{0, 0}, {20, 0}}, packing);
+    REQUIRE(packing.size() == 2);
+    CHECK(packing[0].cx == 1);
+    CHECK(packing[0].cy == 1);
+    CHECK(packing[1].cx == 20);
+    CHECK(packing[1].cy == 1);
+}
+
+TEST_CASE("Tallest is placed first and shelves start below the previous", "[packing]") {
+    std::vector<Rect> packing;
+    // Roughly square is 19 pixels wide, one size per shelf
+    const auto packed = PackShelves({{10, 5}, {10, 20}, {10, 10}}, packing);
+    REQUIRE(packing.size() == 3);
+    CHECK(packing[1].y == 0);
+    CHECK(packing[2].y == 20);
+    CHECK(packing[0].y == 30);
+    CHECK(packed.cx == 10);
+    CHECK(packed.cy == 35);
+}
+
+TEST_CASE("Sizes on a shelf are placed after each other", "[packing]") {
+    std::vector<Rect> packing;
+    // Roughly square is 21 pixels wide, two sizes per shelf
+    const auto packed = PackShelves({{10, 12}, {10, 11}, {10, 10}, {10, 9}}, packing);
+    REQUIRE(packing.size() == 4);
+    CHECK(packing[0].x == 0);
+    CHECK(packing[1].x == 10);
+    CHECK(packing[1].y == 0);
+    CHECK(packing[2].x == 0);
+    CHECK(packing[2].y == 12);
+    CHECK(packing[3].x == 10);
+    CHECK(packing[3].y == 12);
+    CHECK(packed.cx == 20);
+    CHECK(packed.cy == 22);
+}
+
+TEST_CASE("Widest size sets the width", "[packing]") {
+    std::vector<Rect> packing;
+    const auto packed = PackShelves({{100, 10}, {40, 10}, {40, 10}}, packing);
+    CHECK(packed.cx == 100);
+    CHECK(packed.cy == 20);
+}
+
+TEST_CASE("Packed sizes do not overlap and fit in packed size", "[packing]") {
+    const std::vector<Size> sizes = {{1920, 40}, {300, 200}, {120, 120}, {500, 30}, {60, 60},
+                                     {200, 200}, {0, 0},     {800, 90},  {90, 800}, {33, 17}};
+    std::vector<Rect> packing;
+    const auto packed = PackShelves(sizes, packing);
+    REQUIRE(packing.size() == sizes.size());
+    for (size_t i = 0; i < sizes.size(); i++) {
+        const auto& rect = packing[i];
+        CHECK(rect.cx == std::max(sizes[i].cx, 1));
+        CHECK(rect.cy == std::max(sizes[i].cy, 1));
+        CHECK(rect.x >= 0);
+        CHECK(rect.y >= 0);
+        CHECK(rect.x + rect.cx <= packed.cx);
+        CHECK(rect.y + rect.cy <= packed.cy);
+        for (size_t j = i + 1; j < sizes.size(); j++) {
+            CHECK_FALSE(Overlaps(rect, packing[j]));
+        }
+    }
+}
+
+int main(int argc, char* argv[]) { return Catch::Session().run(argc, argv); }
@@ -0,0 +1,385 @@
+#include <catch2/catch_session.hpp>
+#include <catch2/catch_test_macros.hpp>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "zen/ImageCache.h"
+#include "zen/RenderTree.h"
+
+// Flex containers of bars, bars are measured from their size only and need no cairo context
+struct Flex {
+    RenderTree tree;
+    uint32_t first;
+
+    explicit Flex(const std::vector<Size>& sizes) {
+        const auto root = tree.Add(NodeType::Flex);
+        first = tree.AddChildren(root, sizes.size());
+        for (size_t i = 0; i < sizes.size(); i++) {
+            auto& bar = tree.At(first + i);
+            bar.type = NodeType::Bar;
+            bar.size = sizes[i];
+        }
+    }
+    Node& Root() { return tree.At(0); }
+    Node& Item(uint32_t i) { return tree.At(first + i); }
+    const Rect& Frame(uint32_t i) { return Item(i).frame; }
+    void Compute() {
+        tree.HashNodes();
+        tree.Compute(nullptr);
+    }
+};
+
+TEST_CASE("Row places items after each other", "[flex]") {
+    Flex flex({{20, 10}, {30, 15}});
+    flex.Compute();
+    CHECK(flex.tree.Computed().cx == 50);
+    CHECK(flex.tree.Computed().cy == 15);
+    CHECK(flex.Frame(0).x == 0);
+    CHECK(flex.Frame(1).x == 20);
+    CHECK(flex.Frame(1).y == 0);
+}
+
+TEST_CASE("Column places items below each other", "[flex]") {
+    Flex flex({{20, 10}, {30, 15}});
+    flex.Root().isColumn = true;
+    flex.Compute();
+    CHECK(flex.tree.Computed().cx == 30);
+    CHECK(flex.tree.Computed().cy == 25);
+    CHECK(flex.Frame(1).x == 0);
+    CHECK(flex.Frame(1).y == 10);
+}
+
+TEST_CASE("Padding is around every item and gap between them", "[flex]") {
+    Flex flex({{20, 10}, {20, 10}});
+    flex.Root().padding = Padding{.left = 2, .right = 2, .top = 1, .bottom = 1};
+    flex.Root().gap = 5;
+    flex.Compute();
+    CHECK(flex.tree.Computed().cx == 53);
+    CHECK(flex.tree.Computed().cy == 12);
+    CHECK(flex.Frame(0).x == 2);
+    CHECK(flex.Frame(0).y == 1);
+    CHECK(flex.Frame(1).x == 31);
+}
+
+TEST_CASE("Empty items take no space", "[flex]") {
+    Flex flex({{20, 10}, {20, 10}, {20, 10}});
+    flex.Item(1).type = NodeType::Empty;
+    flex.Root().gap = 5;
+    flex.Compute();
+    CHECK(flex.tree.Computed().cx == 45);
+    CHECK(flex.Frame(2).x == 25);
+}
+
+TEST_CASE("Justify distributes free space along main axis", "[flex]") {
+    Flex flex({{20, 10}, {20, 10}});
+    // 60 pixels free
+    flex.Root().minSize = Size{100, 10};
+    auto positions = [&flex](FlexJustify justify) {
+        flex.Root().justify = justify;
+        flex.Compute();
+        return std::vector<int>{flex.Frame(0).x, flex.Frame(1).x};
+    };
+    CHECK(positions(FlexJustify::Start) == std::vector<int>{0, 20});
+    CHECK(positions(FlexJustify::End) == std::vector<int>{60, 80});
+    CHECK(positions(FlexJustify::Center) == std::vector<int>{30, 50});
+    CHECK(positions(FlexJustify::SpaceBetween) == std::vector<int>{0, 80});
+    CHECK(positions(FlexJustify::SpaceAround) == std::vector<int>{15, 65});
+    CHECK(positions(FlexJustify::SpaceEvenly) == std::vector<int>{20, 60});
+}
+
+TEST_CASE("Align places items along cross axis of the line", "[flex]") {
+    Flex flex({{20, 10}, {20, 20}});
+    flex.Root().minSize = Size{40, 30};
+    auto place = [&flex](FlexAlign align) {
+        flex.Root().align = align;
+        flex.Compute();
+        return std::vector<int>{flex.Frame(0).y, flex.Frame(0).cy, flex.Frame(1).y,
+                                flex.Frame(1).cy};
+    };
+    CHECK(place(FlexAlign::Start) == std::vector<int>{0, 10, 0, 20});
+    CHECK(place(FlexAlign::End) == std::vector<int>{20, 10, 10, 20});
+    CHECK(place(FlexAlign::Center) == std::vector<int>{10, 10, 5, 20});
+    CHECK(place(FlexAlign::Stretch) == std::vector<int>{0, 30, 0, 30});
+}
+
+TEST_CASE("Stretch is limited by max size of item", "[flex]") {
+    Flex flex({{20, 10}, {20, 20}});
+    flex.Root().minSize = Size{40, 30};
+    flex.Root().align = FlexAlign::Stretch;
+    flex.Item(0).maxSize = Size{0, 25};
+    flex.Compute();
+    CHECK(flex.Frame(0).cy == 25);
+    CHECK(flex.Frame(1).cy == 30);
+}
+
+TEST_CASE("Wrap breaks lines at max size", "[flex]") {
+    Flex flex({{20, 10}, {20, 10}, {20, 10}});
+    flex.Root().wrap = true;
+    flex.Root().maxSize = Size{50, 0};
+    flex.Root().gap = 5;
+    flex.Compute();
+    // Two items and one gap fits on the first line
+    CHECK(flex.tree.Computed().cx == 45);
+    CHECK(flex.tree.Computed().cy == 25);
+    CHECK(flex.Frame(1).x == 25);
+    CHECK(flex.Frame(1).y == 0);
+    CHECK(flex.Frame(2).x == 0);
+    CHECK(flex.Frame(2).y == 15);
+}
+
+TEST_CASE("Without wrap items stay on one line", "[flex]") {
+    Flex flex({{20, 10}, {20, 10}, {20, 10}});
+    flex.Root().maxSize = Size{50, 0};
+    flex.Compute();
+    CHECK(flex.tree.Computed().cx == 50);
+    CHECK(flex.Frame(2).y == 0);
+}
+
+TEST_CASE("Free space is given to items by grow factor", "[flex]") {
+    Flex flex({{20, 10}, {20, 10}});
+    flex.Root().minSize = Size{100, 10};
+    flex.Item(0).grow = 1;
+    flex.Item(1).grow = 3;
+    flex.Compute();
+    CHECK(flex.Frame(0).cx == 35);
+    CHECK(flex.Frame(1).x == 35);
+    CHECK(flex.Frame(1).cx == 65);
+}
+
+TEST_CASE("Missing space is taken from items by shrink factor and size", "[flex]") {
+    Flex flex({{40, 10}, {60, 10}});
+    flex.Root().maxSize = Size{60, 0};
+    flex.Compute();
+    CHECK(flex.tree.Computed().cx == 60);
+    CHECK(flex.Frame(0).cx == 24);
+    CHECK(flex.Frame(1).x == 24);
+    CHECK(flex.Frame(1).cx == 36);
+}
+
+TEST_CASE("Items that does not shrink keep their size", "[flex]") {
+    Flex flex({{40, 10}, {60, 10}});
+    flex.Root().maxSize = Size{60, 0};
+    flex.Item(0).shrink = 0;
+    flex.Compute();
+    CHECK(flex.Frame(0).cx == 40);
+    CHECK(flex.Frame(1).cx == 20);
+}
+
+TEST_CASE("Grow and shrink are limited by min and max size of item", "[flex]") {
+    SECTION("Grow") {
+        Flex flex({{20, 10}, {20, 10}});
+        flex.Root().minSize = Size{100, 10};
+        flex.Item(0).grow = 1;
+        flex.Item(0).maxSize = Size{30, 0};
+        flex.Item(1).grow = 1;
+        flex.Compute();
+        CHECK(flex.Frame(0).cx == 30);
+        CHECK(flex.Frame(1).x == 30);
+        CHECK(flex.Frame(1).cx == 50);
+    }
+    SECTION("Shrink") {
+        Flex flex({{40, 10}, {60, 10}});
+        flex.Root().maxSize = Size{60, 0};
+        flex.Item(0).minSize = Size{35, 0};
+        flex.Compute();
+        CHECK(flex.Frame(0).cx == 35);
+        CHECK(flex.Frame(1).x == 35);
+        CHECK(flex.Frame(1).cx == 36);
+    }
+}
+
+TEST_CASE("Measured size is limited by min and max size", "[flex]") {
+    Flex flex({{20, 10}});
+    flex.Item(0).minSize = Size{25, 0};
+    flex.Item(0).maxSize = Size{0, 5};
+    flex.Compute();
+    CHECK(flex.Item(0).measured.cx == 25);
+    CHECK(flex.Item(0).measured.cy == 5);
+}
+
+// Bar, gauge and sparkline in a row, measured without a cairo context
+struct Meters {
+    RenderTree tree;
+
+    Meters() {
+        const auto root = tree.Add(NodeType::Flex);
+        const auto first = tree.AddChildren(root, 3);
+        tree.At(first).type = NodeType::Bar;
+        tree.At(first + 1).type = NodeType::Gauge;
+        tree.At(first + 2).type = NodeType::Sparkline;
+    }
+    Node& Bar() { return tree.At(1); }
+    Node& Gauge() { return tree.At(2); }
+    Node& Sparkline() { return tree.At(3); }
+    void Compute() {
+        tree.HashNodes();
+        tree.Compute(nullptr);
+    }
+};
+
+TEST_CASE("Meters are measured by their size", "[meter]") {
+    Meters meters;
+    meters.Bar().size = Size{60, 8};
+    meters.Gauge().size = Size{24, 24};
+    meters.Sparkline().size = Size{60, 20};
+    meters.Sparkline().values = meters.tree.AddValues({1, 5, 3});
+    meters.Compute();
+    CHECK(meters.Bar().measured.cx == 60);
+    CHECK(meters.Bar().measured.cy == 8);
+    CHECK(meters.Gauge().measured.cx == 24);
+    CHECK(meters.Gauge().measured.cy == 24);
+    // Not by the number of samples
+    CHECK(meters.Sparkline().measured.cx == 60);
+    CHECK(meters.Sparkline().measured.cy == 20);
+    CHECK(meters.tree.Computed().cx == 144);
+    CHECK(meters.tree.Computed().cy == 24);
+    CHECK(meters.Sparkline().frame.x == 84);
+}
+
+TEST_CASE("Meters are limited by min and max size", "[meter]") {
+    Meters meters;
+    meters.Bar().size = Size{60, 8};
+    meters.Bar().maxSize = Size{40, 0};
+    meters.Gauge().size = Size{24, 24};
+    meters.Gauge().minSize = Size{32, 32};
+    meters.Compute();
+    CHECK(meters.Bar().measured.cx == 40);
+    CHECK(meters.Bar().measured.cy == 8);
+    CHECK(meters.Gauge().measured.cx == 32);
+    CHECK(meters.Gauge().measured.cy == 32);
+    // No size takes no space
+    CHECK(meters.Sparkline().measured.cx == 0);
+    CHECK(meters.Sparkline().measured.cy == 0);
+}
+
+TEST_CASE("Meters hash their values", "[meter]") {
+    auto hash = [](float value, std::vector<float> values) {
+        Meters meters;
+        meters.Bar().value = value;
+        meters.Gauge().value = value;
+        meters.Sparkline().values = meters.tree.AddValues(values);
+        meters.Compute();
+        return std::vector<size_t>{meters.Bar().hash, meters.Gauge().hash,
+                                   meters.Sparkline().hash};
+    };
+    const auto hashes = hash(50, {1, 2});
+    CHECK(hash(50, {1, 2}) == hashes);
+    const auto changedValue = hash(60, {1, 2});
+    CHECK(changedValue[0] != hashes[0]);
+    CHECK(changedValue[1] != hashes[1]);
+    const auto newSample = hash(50, {1, 2, 2});
+    CHECK(newSample[2] != hashes[2]);
+}
+
+TEST_CASE("Missing image dimension keeps the aspect ratio", "[image]") {
+    // Both given, the image is stretched
+    CHECK(ImageCache::ResolveSize({30, 30}, 40, 20) == Size{30, 30});
+    CHECK(ImageCache::ResolveSize({30, 0}, 40, 20) == Size{30, 15});
+    CHECK(ImageCache::ResolveSize({0, 30}, 40, 20) == Size{60, 30});
+    // Rounded to nearest
+    CHECK(ImageCache::ResolveSize({0, 10}, 16, 9) == Size{18, 10});
+    CHECK(ImageCache::ResolveSize({0, 0}, 40.4, 19.6) == Size{40, 20});
+}
+
+// Image files written to a directory of their own, removed when done
+struct ImageFiles {
+    std::filesystem::path dir;
+    cairo_surface_t* target;
+    cairo_t* cr;
+
+    ImageFiles()
+        : dir(std::filesystem::temp_directory_path() / "zenway-test-images"),
+          target(cairo_image_surface_create(CAIRO_FORMAT_ARGB32, 100, 100)),
+          cr(cairo_create(target)) {
+        std::filesystem::create_directories(dir);
+    }
+    ~ImageFiles() {
+        cairo_destroy(cr);
+        cairo_surface_destroy(target);
+        std::filesystem::remove_all(dir);
+    }
+    std::string Png(const char* name, int cx, int cy) {
+        auto path = (dir / name).string();
+        auto surface = cairo_image_surface_create(CAIRO_FORMAT_ARGB32, cx, cy);
+        cairo_surface_write_to_png(surface, path.c_str());
+        cairo_surface_destroy(surface);
+        return path;
+    }
+    std::string Svg(const char* name, const char* attributes) {
+        auto path = (dir / name).string();
+        std::ofstream(path) << "<svg xmlns='http://www.w3.org/2000/svg' " << attributes
+                            << "><rect width='100%' height='100%' fill='red'/></svg>";
+        return path;
+    }
+};
+
+TEST_CASE("Images are scaled to the size with missing dimension from the image", "[image]") {
+    ImageFiles files;
+    auto cache = ImageCache::Create(8);
+    const auto png = files.Png("wide.png", 40, 20);
+    const auto svg = files.Svg("wide.svg", "width='40' height='20'");
+    for (const auto& path : {png, svg}) {
+        INFO(path);
+        Size drawn;
+        auto image = cache->Get(files.cr, path, {0, 10}, drawn);
+        REQUIRE(image);
+        CHECK(drawn == Size{20, 10});
+        CHECK(cairo_image_surface_get_width(image) == 20);
+        CHECK(cairo_image_surface_get_height(image) == 10);
+        cairo_surface_destroy(image);
+        image = cache->Get(files.cr, path, {0, 0}, drawn);
+        REQUIRE(image);
+        CHECK(drawn == Size{40, 20});
+        cairo_surface_destroy(image);
+    }
+}
+
+TEST_CASE("Failed loads are cached", "[image]") {
+    ImageFiles files;
+    auto cache = ImageCache::Create(8);
+    const auto missing = (files.dir / "missing.png").string();
+    const auto broken = files.Svg("broken.svg", "width='10' height='10'><unclosed");
+    for (const auto& path : {missing, broken}) {
+        INFO(path);
+        Size drawn{1, 1};
+        CHECK(cache->Get(files.cr, path, {10, 10}, drawn) == nullptr);
+        CHECK(drawn == Size{});
+        const auto misses = cache->GetStats().misses;
+        // Not loaded again
+        drawn = Size{1, 1};
+        CHECK(cache->Get(files.cr, path, {10, 10}, drawn) == nullptr);
+        CHECK(drawn == Size{});
+        CHECK(cache->GetStats().misses == misses);
+    }
+    CHECK(cache->GetStats().hits == 2);
+    // Loaded once it exists, when the cached failure has been evicted
+    auto evicting = ImageCache::Create(1);
+    Size drawn;
+    CHECK(evicting->Get(files.cr, missing, {10, 10}, drawn) == nullptr);
+    CHECK(evicting->Get(files.cr, broken, {10, 10}, drawn) == nullptr);
+    files.Png("missing.png", 10, 10);
+    auto image = evicting->Get(files.cr, missing, {10, 10}, drawn);
+    CHECK(image);
+    if (image) cairo_surface_destroy(image);
+}
+
+TEST_CASE("SVG with only a view box needs both dimensions", "[image]") {
+    ImageFiles files;
+    auto cache = ImageCache::Create(8);
+    const auto svg = files.Svg("viewbox.svg", "viewBox='0 0 40 20'");
+    Size drawn;
+    auto image = cache->Get(files.cr, svg, {30, 30}, drawn);
+    REQUIRE(image);
+    CHECK(drawn == Size{30, 30});
+    CHECK(cairo_image_surface_get_width(image) == 30);
+    CHECK(cairo_image_surface_get_height(image) == 30);
+    cairo_surface_destroy(image);
+    // Nothing to take a missing dimension from
+    CHECK(cache->Get(files.cr, svg, {30, 0}, drawn) == nullptr);
+    CHECK(cache->Get(files.cr, svg, {0, 0}, drawn) == nullptr);
+    CHECK(drawn == Size{});
+}
+
+int main(int argc, char* argv[]) { return Catch::Session().run(argc, argv); }
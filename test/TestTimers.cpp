@@ -0,0 +1,101 @@
+#include <poll.h>
+
+#include <catch2/catch_session.hpp>
+#include <catch2/catch_test_macros.hpp>
+#include <chrono>
+#include <vector>
+
+#include "zen/Timers.h"
+
+using namespace std::chrono_literals;
+using Clock = std::chrono::steady_clock;
+
+class CountingHandler : public TimerHandler {
+   public:
+    bool OnTimeout() override {
+        firedAt.push_back(Clock::now());
+        return true;
+    }
+    std::vector<Clock::time_point> firedAt;
+};
+
+// Timers run on the monotonic clock through a timerfd. Checks are lower bounds which hold however
+// late the test is woken up, timers that must not fire are due seconds later than the ones that
+// should, to leave a busy machine plenty of time.
+
+// Blocks until the timerfd expires and lets the timers handle it
+static bool WaitAndRead(Timers& timers) {
+    pollfd pfd{.fd = timers.Fd(), .events = POLLIN, .revents = 0};
+    if (poll(&pfd, 1, 5000) != 1) {
+        return false;
+    }
+    return timers.OnRead();
+}
+
+TEST_CASE("Timer fires after initial timeout", "[timers]") {
+    auto timers = Timers::Create();
+    REQUIRE(timers);
+    auto handler = std::make_shared<CountingHandler>();
+    const auto start = Clock::now();
+    timers->Add("a", 20ms, 5000ms, 0ms, handler);
+    CHECK(WaitAndRead(*timers));
+    REQUIRE(handler->firedAt.size() == 1);
+    CHECK(handler->firedAt[0] - start >= 20ms);
+}
+
+TEST_CASE("Timer is delayed within its slack to coalesce with later timer", "[timers]") {
+    auto timers = Timers::Create();
+    REQUIRE(timers);
+    auto early = std::make_shared<CountingHandler>();
+    auto late = std::make_shared<CountingHandler>();
+    const auto start = Clock::now();
+    // Early timer is allowed to be delayed until the late timer is due
+    timers->Add("early", 10ms, 5000ms, 1000ms, early);
+    timers->Add("late", 40ms, 5000ms, 0ms, late);
+    CHECK(WaitAndRead(*timers));
+    // Both in the same wakeup
+    REQUIRE(early->firedAt.size() == 1);
+    REQUIRE(late->firedAt.size() == 1);
+    CHECK(early->firedAt[0] - start >= 40ms);
+}
+
+TEST_CASE("Timer is not delayed past its slack", "[timers]") {
+    auto timers = Timers::Create();
+    REQUIRE(timers);
+    auto early = std::make_shared<CountingHandler>();
+    auto late = std::make_shared<CountingHandler>();
+    timers->Add("early", 10ms, 5000ms, 10ms, early);
+    timers->Add("late", 3000ms, 5000ms, 0ms, late);
+    CHECK(WaitAndRead(*timers));
+    CHECK(early->firedAt.size() == 1);
+    CHECK(late->firedAt.empty());
+}
+
+TEST_CASE("Periodic timer is rescheduled", "[timers]") {
+    auto timers = Timers::Create();
+    REQUIRE(timers);
+    auto handler = std::make_shared<CountingHandler>();
+    const auto start = Clock::now();
+    timers->Add("periodic", 10ms, 20ms, 0ms, handler);
+    CHECK(WaitAndRead(*timers));
+    CHECK(WaitAndRead(*timers));
+    REQUIRE(handler->firedAt.size() == 2);
+    // Second timeout is a period after the first deadline, however late the first one was handled
+    CHECK(handler->firedAt[0] - start >= 10ms);
+    CHECK(handler->firedAt[1] - start >= 30ms);
+}
+
+TEST_CASE("Removed timer does not fire", "[timers]") {
+    auto timers = Timers::Create();
+    REQUIRE(timers);
+    auto removed = std::make_shared<CountingHandler>();
+    auto kept = std::make_shared<CountingHandler>();
+    auto id = timers->Add("removed", 10ms, 5000ms, 0ms, removed);
+    timers->Add("kept", 30ms, 5000ms, 0ms, kept);
+    timers->Remove(id);
+    CHECK(WaitAndRead(*timers));
+    CHECK(removed->firedAt.empty());
+    CHECK(kept->firedAt.size() == 1);
+}
+
+int main(int argc, char* argv[]) { return Catch::Session().run(argc, argv); }
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+// Blending of coverage masks in a single color onto premultiplied ARGB32 pixels, color is
+// premultiplied in memory order of the pixels. Blended pixels are the same whichever variant is
+// used.
+
+inline uint32_t Div255(uint32_t x) {
+    x += 128;
+    return (x + (x >> 8)) >> 8;
+}
+
+inline void BlendMaskRowScalar(uint32_t *d, const uint8_t *m, int x, int cx,
+                               const uint8_t color[4]) {
+    for (; x < cx; x++) {
+        uint32_t coverage = m[x];
+        if (!coverage) continue;
+        auto p = (uint8_t *)(d + x);
+        auto alpha = Div255(color[3] * coverage);
+        for (int c = 0; c < 4; c++) {
+            p[c] = Div255(color[c] * coverage) + Div255(p[c] * (255 - alpha));
+        }
+    }
+}
+
+inline void BlendMaskScalar(uint8_t *dst, int dstStride, const uint8_t *mask, int maskStride,
+                            int cx, int cy, const uint8_t color[4]) {
+    for (int y = 0; y < cy; y++) {
+        BlendMaskRowScalar((uint32_t *)(dst + y * dstStride), mask + y * maskStride, 0, cx, color);
+    }
+}
+
+// Four pixels at a time where SSE2 is available, the rest of each row as scalar
+inline void BlendMask(uint8_t *dst, int dstStride, const uint8_t *mask, int maskStride, int cx,
+                      int cy, const uint8_t color[4]) {
+#ifdef __SSE2__
+    const auto zero = _mm_setzero_si128();
+    const auto round = _mm_set1_epi16(128);
+    const auto max = _mm_set1_epi16(255);
+    uint32_t packedColor;
+    std::memcpy(&packedColor, color, 4);
+    const auto src = _mm_unpacklo_epi8(_mm_set1_epi32(packedColor), zero);
+    auto blend = [&](__m128i coverage16, __m128i dst16) {
+        // Source scaled by coverage
+        auto s = _mm_mullo_epi16(src, coverage16);
+        s = _mm_add_epi16(s, round);
+        s = _mm_srli_epi16(_mm_add_epi16(s, _mm_srli_epi16(s, 8)), 8);
+        // Destination scaled by inverse source alpha
+        auto a = _mm_shufflelo_epi16(s, _MM_SHUFFLE(3, 3, 3, 3));
+        a = _mm_shufflehi_epi16(a, _MM_SHUFFLE(3, 3, 3, 3));
+        auto t = _mm_mullo_epi16(dst16, _mm_sub_epi16(max, a));
+        t = _mm_add_epi16(t, round);
+        t = _mm_srli_epi16(_mm_add_epi16(t, _mm_srli_epi16(t, 8)), 8);
+        return _mm_add_epi16(s, t);
+    };
+#endif
+    for (int y = 0; y < cy; y++) {
+        auto d = (uint32_t *)(dst + y * dstStride);
+        auto m = mask + y * maskStride;
+        int x = 0;
+#ifdef __SSE2__
+        for (; x + 4 <= cx; x += 4) {
+            uint32_t coverage;
+            std::memcpy(&coverage, m + x, 4);
+            if (!coverage) continue;
+            // Broadcast coverage of each pixel to its four channels
+            auto m8 = _mm_cvtsi32_si128(coverage);
+            m8 = _mm_unpacklo_epi8(m8, m8);
+            m8 = _mm_unpacklo_epi16(m8, m8);
+            auto pixels = _mm_loadu_si128((const __m128i *)(d + x));
+            auto lo = blend(_mm_unpacklo_epi8(m8, zero), _mm_unpacklo_epi8(pixels, zero));
+            auto hi = blend(_mm_unpackhi_epi8(m8, zero), _mm_unpackhi_epi8(pixels, zero));
+            _mm_storeu_si128((__m128i *)(d + x), _mm_packus_epi16(lo, hi));
+        }
+#endif
+        BlendMaskRowScalar(d, m, x, cx, color);
+    }
+}
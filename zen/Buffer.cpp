@@ -3,7 +3,9 @@
 #include <fcntl.h>
 #include <spdlog/spdlog.h>
 #include <sys/mman.h>
+#include <unistd.h>
 
+#include <algorithm>
 #include <cstring>
 
 static void on_release(void *data, struct wl_buffer *) { ((Buffer *)data)->OnRelease(); }
@@ -12,81 +14,300 @@ const struct wl_buffer_listener listener = {
     .release = on_release,
 };
 
-Buffer::Buffer(wl_buffer *buffer, void *address, int cx, int cy, size_t sizeInBytes)
-    : m_wlbuffer(buffer),
-      m_inUse(false),
+// Buffers that are larger than this times what is needed for a number of frames are shrunk
+static constexpr size_t shrinkFactor = 4;
+static constexpr int shrinkAfterFrames = 30;
+
+static size_t PageAlign(size_t size) {
+    const size_t page = 4096;
+    return (size + page - 1) & ~(page - 1);
+}
+
+Buffer::Buffer(wl_shm &shm, int fd, void *address, size_t capacity)
+    : m_shm(shm),
+      m_fd(fd),
       m_address(address),
-      m_cx(cx),
-      m_cy(cy),
-      m_sizeInBytes(sizeInBytes),
+      m_capacity(capacity),
+      m_pool(nullptr),
+      m_poolCapacity(0),
+      m_isPoolStale(false),
+      m_wlbuffer(nullptr),
+      m_wlbufferCx(0),
+      m_wlbufferCy(0),
+      m_numLocks(0),
+      m_numAttached(0),
+      m_cx(0),
+      m_cy(0),
+      m_sizeInBytes(0),
       m_cr_surface(nullptr),
-      m_cr(nullptr) {}
+      m_cr(nullptr),
+      m_frame(0),
+      m_purgeOnRelease(false) {}
 
-std::unique_ptr<Buffer> Buffer::Create(wl_buffer *wlbuffer, void *address, int cx, int cy) {
-    const int stride = cx * 4;
-    const int size = stride * cy;
-    auto buffer = std::unique_ptr<Buffer>(new Buffer(wlbuffer, address, cx, cy, size));
-    buffer->m_cr_surface = cairo_image_surface_create_for_data((uint8_t *)address,
-                                                               CAIRO_FORMAT_ARGB32, cx, cy, stride);
-    buffer->m_cr = cairo_create(const_cast<cairo_surface_t *>(buffer->m_cr_surface));
-    wl_buffer_add_listener(wlbuffer, &listener, buffer.get());
+bool Buffer::MapMemFd(size_t capacity, int &fd, void *&address) {
+    // Anonymous, nothing to clean up and no collisions with other instances
+    fd = memfd_create("zenway-buffer", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+    if (fd < 0) {
+        spdlog::error("Failed to create mem fd: {}", strerror(errno));
+        return false;
+    }
+    int ret = ftruncate(fd, capacity);
+    if (ret == -1) {
+        spdlog::error("Failed to set initial size of mem fd: {}", strerror(errno));
+        close(fd);
+        return false;
+    }
+    // The compositor can rely on the memory not to shrink, growing is still allowed
+    if (fcntl(fd, F_ADD_SEALS, F_SEAL_SHRINK) == -1) {
+        spdlog::warn("Failed to seal mem fd: {}", strerror(errno));
+    }
+    address = mmap(nullptr, capacity, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (address == MAP_FAILED) {
+        spdlog::error("Failed to mmap initial fd: {}", strerror(errno));
+        close(fd);
+        return false;
+    }
+    return true;
+}
+
+std::unique_ptr<Buffer> Buffer::Create(wl_shm &shm, int cx, int cy) {
+    const size_t capacity = PageAlign((size_t)cx * 4 * cy);
+    int fd;
+    void *address;
+    if (!MapMemFd(capacity, fd, address)) {
+        return nullptr;
+    }
+    auto buffer = std::unique_ptr<Buffer>(new Buffer(shm, fd, address, capacity));
+    buffer->CreateSurface(cx, cy);
+    spdlog::debug("Created buffer {}x{} with capacity {}", cx, cy, capacity);
     return buffer;
 }
 
-Buffer::~Buffer() {
-    cairo_surface_destroy(const_cast<cairo_surface_t *>(m_cr_surface));
-    cairo_destroy(m_cr);
-    wl_buffer_destroy(m_wlbuffer);
+void Buffer::CreateSurface(int cx, int cy) {
+    const int stride = cx * 4;
+    m_cx = cx;
+    m_cy = cy;
+    m_sizeInBytes = stride * cy;
+    m_cr_surface = cairo_image_surface_create_for_data((uint8_t *)m_address, CAIRO_FORMAT_ARGB32,
+                                                       cx, cy, stride);
+    m_cr = cairo_create(m_cr_surface);
 }
 
-void Buffer::Clear(uint8_t v) { memset(const_cast<void *>(m_address), v, m_sizeInBytes); }
+void Buffer::DestroySurface() {
+    if (m_cr) {
+        cairo_destroy(m_cr);
+        m_cr = nullptr;
+    }
+    if (m_cr_surface) {
+        cairo_surface_destroy(m_cr_surface);
+        m_cr_surface = nullptr;
+    }
+}
 
-void Buffer::OnRelease() {
-    spdlog::trace("Event wl_buffer::release");
-    m_inUse = false;
+void Buffer::DestroyWaylandObjects() {
+    if (m_wlbuffer) {
+        wl_buffer_destroy(m_wlbuffer);
+        m_wlbuffer = nullptr;
+    }
+    if (m_pool) {
+        wl_shm_pool_destroy(m_pool);
+        m_pool = nullptr;
+    }
+    m_poolCapacity = 0;
+    m_isPoolStale = false;
 }
 
-std::unique_ptr<BufferPool> BufferPool::Create(wl_shm &shm, const int n, const int cx,
-                                               const int cy) {
-    auto fname = "/zenbuffers";
-    int fd = shm_open(fname, O_RDWR | O_CREAT, 0600);
-    if (fd < 0) {
-        spdlog::error("Failed to shm_open double buffer: {}", strerror(errno));
-        return nullptr;
+Buffer::~Buffer() {
+    DestroySurface();
+    DestroyWaylandObjects();
+    munmap(m_address, m_capacity);
+    close(m_fd);
+}
+
+wl_buffer *Buffer::Lock() {
+    m_numLocks++;
+    if (m_isPoolStale) {
+        DestroyWaylandObjects();
     }
-    const size_t stride = cx * 4;
-    const size_t size = cy * stride;
-    const size_t total_size = size * n;
-    int ret = ftruncate(fd, total_size);
-    if (ret == -1) {
-        spdlog::error("Failed to set initial size of mem fd: ");
-        return nullptr;
+    if (!m_pool) {
+        m_pool = wl_shm_create_pool(&m_shm, m_fd, m_capacity);
+        m_poolCapacity = m_capacity;
+    } else if (m_poolCapacity < m_capacity) {
+        // Shm pools can only grow
+        wl_shm_pool_resize(m_pool, m_capacity);
+        m_poolCapacity = m_capacity;
     }
-    auto address = mmap(nullptr, total_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
-    if (address == MAP_FAILED) {
-        spdlog::error("Failed to mmap initial fd: ");
-        return nullptr;
+    if (m_wlbuffer && (m_wlbufferCx != m_cx || m_wlbufferCy != m_cy)) {
+        wl_buffer_destroy(m_wlbuffer);
+        m_wlbuffer = nullptr;
     }
-    auto pool = wl_shm_create_pool(&shm, fd, total_size);
-    Buffers buffers(n);
-    for (int i = 0; i < n; i++) {
-        auto buffer = Buffer::Create(
-            wl_shm_pool_create_buffer(pool, size * i, cx, cy, stride, WL_SHM_FORMAT_ARGB8888),
-            ((uint8_t *)address) + (size * i), cx, cy);
-        if (!buffer) {
+    if (!m_wlbuffer) {
+        m_wlbuffer =
+            wl_shm_pool_create_buffer(m_pool, 0, m_cx, m_cy, m_cx * 4, WL_SHM_FORMAT_ARGB8888);
+        if (!m_wlbuffer) {
+            spdlog::error("Failed to create buffer {}x{}", m_cx, m_cy);
             return nullptr;
         }
-        buffers[i] = std::move(buffer);
+        m_wlbufferCx = m_cx;
+        m_wlbufferCy = m_cy;
+        wl_buffer_add_listener(m_wlbuffer, &listener, this);
     }
-    return std::unique_ptr<BufferPool>(new BufferPool(std::move(buffers)));
+    return m_wlbuffer;
+}
+
+bool Buffer::Reshape(int cx, int cy) {
+    if (cx == m_cx && cy == m_cy) {
+        return true;
+    }
+    // Grow first, the buffer is kept as is when growing fails
+    const size_t size = (size_t)cx * 4 * cy;
+    if (size > m_capacity) {
+        // The shm pool is resized when locked
+        const size_t capacity = PageAlign(size);
+        if (ftruncate(m_fd, capacity) == -1) {
+            spdlog::error("Failed to grow mem fd: {}", strerror(errno));
+            return false;
+        }
+        auto address = mremap(m_address, m_capacity, capacity, MREMAP_MAYMOVE);
+        if (address == MAP_FAILED) {
+            spdlog::error("Failed to remap grown mem fd: {}", strerror(errno));
+            return false;
+        }
+        spdlog::debug("Grown buffer from {} to {}", m_capacity, capacity);
+        m_address = address;
+        m_capacity = capacity;
+    }
+    DestroySurface();
+    SetContent(0, {});
+    CreateSurface(cx, cy);
+    return true;
+}
+
+bool Buffer::Shrink(int cx, int cy) {
+    // Shm pools can not shrink, the memory is replaced and a new pool is created when locked
+    const size_t capacity = PageAlign((size_t)cx * 4 * cy);
+    int fd;
+    void *address;
+    if (!MapMemFd(capacity, fd, address)) {
+        return false;
+    }
+    spdlog::debug("Shrinking buffer from {} to {}", m_capacity, capacity);
+    DestroySurface();
+    munmap(m_address, m_capacity);
+    close(m_fd);
+    m_fd = fd;
+    m_address = address;
+    m_capacity = capacity;
+    m_isPoolStale = true;
+    SetContent(0, {});
+    CreateSurface(cx, cy);
+    return true;
+}
+
+void Buffer::Clear(uint8_t v) { memset(m_address, v, m_sizeInBytes); }
+
+void Buffer::ClearRect(const Rect &rect) {
+    const int x0 = std::clamp(rect.x, 0, m_cx);
+    const int x1 = std::clamp(rect.x + rect.cx, 0, m_cx);
+    const int y0 = std::clamp(rect.y, 0, m_cy);
+    const int y1 = std::clamp(rect.y + rect.cy, 0, m_cy);
+    if (x0 >= x1) {
+        return;
+    }
+    const int stride = m_cx * 4;
+    for (int y = y0; y < y1; y++) {
+        memset((uint8_t *)m_address + y * stride + x0 * 4, 0, (x1 - x0) * 4);
+    }
+}
+
+void Buffer::OnRelease() {
+    spdlog::trace("Event wl_buffer::release");
+    if (m_numAttached > 0) {
+        m_numAttached--;
+    }
+    if (m_purgeOnRelease && !InUse()) {
+        Purge();
+    }
+}
+
+void Buffer::Purge() {
+    m_purgeOnRelease = false;
+    // Gives the pages back to the system, they are faulted back in as zeroes when touched
+    if (fallocate(m_fd, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE, 0, m_capacity) == -1) {
+        spdlog::warn("Failed to release buffer memory: {}", strerror(errno));
+        return;
+    }
+    SetContent(0, {});
+    spdlog::debug("Released {} bytes of buffer memory", m_capacity);
+}
+
+std::unique_ptr<BufferPool> BufferPool::Create(wl_shm &shm, const int n, const int maxBuffers) {
+    return std::unique_ptr<BufferPool>(new BufferPool(shm, n, std::max(n, maxBuffers)));
+}
+
+bool BufferPool::IsExhausted() const {
+    if ((int)m_buffers.size() < m_maxBuffers) {
+        return false;
+    }
+    return std::all_of(m_buffers.begin(), m_buffers.end(),
+                       [](const auto &buffer) { return buffer->InUse(); });
 }
 
 // As long as only one thread is running this is ok
-std::shared_ptr<Buffer> BufferPool::Get() {
+void BufferPool::Purge() {
+    for (auto &buffer : m_buffers) {
+        if (buffer->InUse()) {
+            buffer->PurgeOnRelease(true);
+        } else {
+            buffer->Purge();
+        }
+    }
+}
+
+std::shared_ptr<Buffer> BufferPool::Get(int cx, int cy) {
+    // Buffers will be used again, no need to release memory of buffers held by compositor
+    for (auto &buffer : m_buffers) {
+        buffer->PurgeOnRelease(false);
+    }
+    // Zero sized buffers are not allowed
+    cx = std::max(cx, 1);
+    cy = std::max(cy, 1);
+    const size_t size = (size_t)cx * 4 * cy;
+    // Prefer a buffer that already has the requested size
+    std::shared_ptr<Buffer> free;
     for (auto &buffer : m_buffers) {
         if (!buffer->InUse()) {
-            return buffer;
+            if (buffer->Width() == cx && buffer->Height() == cy) {
+                free = buffer;
+                break;
+            }
+            if (!free) free = buffer;
+        }
+    }
+    // Keep track of how many frames in a row that would fit in much smaller buffers
+    if (free && free->Capacity() > size * shrinkFactor) {
+        m_numSmallFrames++;
+    } else {
+        m_numSmallFrames = 0;
+    }
+    if (free && m_numSmallFrames >= shrinkAfterFrames && free->Shrink(cx, cy)) {
+        return free;
+    }
+    if (free) {
+        return free->Reshape(cx, cy) ? free : nullptr;
+    }
+    if ((int)m_buffers.size() < m_maxBuffers) {
+        auto buffer = std::shared_ptr<Buffer>(Buffer::Create(m_shm, cx, cy));
+        if (!buffer) {
+            return nullptr;
+        }
+        m_buffers.push_back(buffer);
+        if ((int)m_buffers.size() > m_numBuffers) {
+            // Compositor holds on to all buffers, add another one to the swapchain
+            m_stats.grown++;
+            spdlog::debug("Buffer pool grown to {} buffers", m_buffers.size());
         }
+        return buffer;
     }
     return nullptr;
 }
@@ -3,46 +3,132 @@
 #include <cairo/cairo.h>
 #include <wayland-client-protocol.h>
 
+#include <algorithm>
 #include <memory>
 #include <vector>
 
-// Represents a single buffer used for rendering
+#include "zen/Configuration.h"
+
+// Represents a single buffer used for rendering. Each buffer is backed by its own memfd and
+// shm pool that grows when the buffer needs to be larger. The buffer can be created, reshaped and
+// drawn to on any thread, the shm pool and wl_buffer are created and resized when the buffer is
+// locked, which is done on the main thread.
 class Buffer {
    public:
-    static std::unique_ptr<Buffer> Create(wl_buffer *buffer, void *address, int cx, int cy);
+    static std::unique_ptr<Buffer> Create(wl_shm &shm, int cx, int cy);
     virtual ~Buffer();
+    // Compositor is done with one attach of the buffer. The same buffer could be attached to
+    // multiple surfaces, it is in use until every attach has been released.
     void OnRelease();
-    wl_buffer *Lock() {
-        m_inUse = true;
-        return m_wlbuffer;
+    // Releases memory used by buffer, content is undefined after this. Must not be in use.
+    void Purge();
+    // Purge when the compositor releases the buffer
+    void PurgeOnRelease(bool purge) { m_purgeOnRelease = purge; }
+    // Each surface that will attach the buffer locks it, the lock is handed over to the
+    // compositor when attached or given back with Unlock if never attached. Makes the Wayland
+    // requests needed for the buffer to match the memory, main thread only. Returns null if the
+    // wl_buffer could not be created.
+    wl_buffer *Lock();
+    void Unlock() { m_numLocks--; }
+    void OnAttached() {
+        m_numLocks--;
+        m_numAttached++;
     }
+    // Changes dimension of buffer, content is undefined after this. Must not be in use.
+    bool Reshape(int cx, int cy);
+    // Replaces the memory with just enough for the dimension, content is undefined after this.
+    // Must not be in use.
+    bool Shrink(int cx, int cy);
 
     cairo_t *GetCairoCtx() { return m_cr; }
     void Clear(uint8_t v);
-    bool InUse() { return m_inUse; }
+    void ClearRect(const Rect &rect);
+    // Frame number of what the buffer contains and where the widgets were drawn, frame 0 means
+    // that the content is undefined.
+    uint64_t Frame() const { return m_frame; }
+    const std::vector<Rect> &WidgetRects() const { return m_widgetRects; }
+    void SetContent(uint64_t frame, const std::vector<Rect> &widgetRects) {
+        m_frame = frame;
+        m_widgetRects = widgetRects;
+    }
+    bool InUse() const { return m_numLocks > 0 || m_numAttached > 0; }
+    int Width() const { return m_cx; }
+    int Height() const { return m_cy; }
+    size_t Capacity() const { return m_capacity; }
 
    private:
-    Buffer(wl_buffer *buffer, void *address, int cx, int cy, size_t sizeInBytes);
+    Buffer(wl_shm &shm, int fd, void *address, size_t capacity);
+    static bool MapMemFd(size_t capacity, int &fd, void *&address);
+    void CreateSurface(int cx, int cy);
+    void DestroySurface();
+    void DestroyWaylandObjects();
 
+    wl_shm &m_shm;
+    int m_fd;
+    void *m_address;
+    size_t m_capacity;
+    // Created when locked, sized to what it was when last locked
+    wl_shm_pool *m_pool;
+    size_t m_poolCapacity;
+    // The pool was created from memory that has been replaced
+    bool m_isPoolStale;
     wl_buffer *m_wlbuffer;
-    bool m_inUse;
-    const void *m_address;
-    const int m_cx;
-    const int m_cy;
-    const size_t m_sizeInBytes;
-    const cairo_surface_t *m_cr_surface;
+    int m_wlbufferCx;
+    int m_wlbufferCy;
+    int m_numLocks;
+    // Attaches not yet released by the compositor
+    int m_numAttached;
+    int m_cx;
+    int m_cy;
+    size_t m_sizeInBytes;
+    cairo_surface_t *m_cr_surface;
     cairo_t *m_cr;
+    uint64_t m_frame;
+    std::vector<Rect> m_widgetRects;
+    bool m_purgeOnRelease;
 };
 
-// Represents a memory map with one or more buffers in it
+// Buffers of a single surface, buffers are sized to what is drawn on the surface.
 class BufferPool {
    public:
-    static std::unique_ptr<BufferPool> Create(wl_shm &shm, const int n, const int cx, const int cy);
-    std::shared_ptr<Buffer> Get();
+    struct Stats {
+        // Draws lost since no buffer could be allocated
+        int dropped;
+        // Draws postponed until a buffer is released by the compositor
+        int deferred;
+        // Buffers added beyond the initial number since the compositor held on to all buffers
+        int grown;
+    };
+
+    // Starts with n buffers and grows up to maxBuffers when all buffers are held by the
+    // compositor.
+    static std::unique_ptr<BufferPool> Create(wl_shm &shm, const int n, const int maxBuffers);
+    // Returns a buffer that is not in use with the requested size or null if all buffers are in
+    // use.
+    std::shared_ptr<Buffer> Get(int cx, int cy);
+    // True when Get will fail until a buffer is released
+    bool IsExhausted() const;
+    // True when buffer was gotten from this pool
+    bool Owns(const std::shared_ptr<Buffer> &buffer) const {
+        return std::find(m_buffers.begin(), m_buffers.end(), buffer) != m_buffers.end();
+    }
+    // Releases memory of all buffers until next Get, buffers held by the compositor are purged
+    // when released.
+    void Purge();
+    void OnDeferred() { m_stats.deferred++; }
+    void OnDropped() { m_stats.dropped++; }
+    const Stats &GetStats() const { return m_stats; }
 
    private:
     using Buffers = std::vector<std::shared_ptr<Buffer>>;
 
-    BufferPool(Buffers &&buffers) : m_buffers(buffers) {}
+    BufferPool(wl_shm &shm, const int n, const int maxBuffers)
+        : m_shm(shm), m_numBuffers(n), m_maxBuffers(maxBuffers), m_numSmallFrames(0), m_stats{} {}
+    wl_shm &m_shm;
+    const int m_numBuffers;
+    const int m_maxBuffers;
+    // Number of consecutive frames that would have fit in a much smaller buffer
+    int m_numSmallFrames;
+    Stats m_stats;
     Buffers m_buffers;
 };
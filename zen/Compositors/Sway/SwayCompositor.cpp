@@ -243,7 +243,9 @@ std::shared_ptr<SwayCompositor> SwayCompositor::Connect(std::shared_ptr<MainLoop
         return nullptr;
     }
     auto t = std::shared_ptr<SwayCompositor>(new SwayCompositor(mainloop, fd, visibility));
-    mainloop->RegisterIoHandler(fd, "Sway", t);
+    if (!mainloop->RegisterIoHandler(fd, "Sway", t)) {
+        return nullptr;
+    }
     t->Initialize();
     return t;
 }
@@ -3,119 +3,81 @@
 #include <functional>
 #include <memory>
 #include <set>
+#include <string>
 #include <vector>
 
 #include "cairo.h"
-#include "pango/pango-layout.h"
-
-struct Padding {
-    int left;
-    int right;
-    int top;
-    int bottom;
-};
-
-struct Size {
-    int cx;
-    int cy;
-};
-
-struct Rect {
-    int x;
-    int y;
-    int cx;
-    int cy;
-
-    bool Contains(int x_, int y_) const {
-        return x_ >= x && x_ <= x + cx && y_ >= y && y_ <= y + cy;
-    }
-};
-
-struct RGBA {
-    double r;
-    double g;
-    double b;
-    double a;
-    static RGBA FromString(const std::string& s);
-};
-
-struct Border {
-    RGBA color;
-    int width;
-};
+#include "zen/RenderTree.h"
 
 enum class Anchor { Left, Right, Top, TopLeft, TopRight, Bottom, BottomLeft, BottomRight, Center };
 
-struct Target {
-    Rect position;
-    std::string tag;
-};
-
-struct Renderable {
-    Renderable() : computed{} {}
-    virtual ~Renderable() {}
-    virtual void Compute(cairo_t*) {}
-    virtual void Draw(cairo_t*, int /*x*/, int /*y*/, std::vector<Target>& /*targets*/) const {}
-    Size computed;
-};
-
-struct Markup : public Renderable {
-    Markup(const std::string& string) : Renderable(), string(string), m_layout(nullptr) {}
-    virtual ~Markup() {
-        if (m_layout) g_object_unref(m_layout);
-    }
-    void Compute(cairo_t* cr) override;
-    void Draw(cairo_t* cr, int x, int y, std::vector<Target>& targets) const override;
-
-   private:
-    const std::string string;
-    PangoLayout* m_layout;
-};
-
-struct MarkupBox : public Renderable {
-    MarkupBox(const std::string& string)
-        : Renderable(), markup(string), color({}), border({}), radius(0), padding({}) {}
-    void Compute(cairo_t* cr) override;
-    void Draw(cairo_t* cr, int x, int y, std::vector<Target>& targets) const override;
-
-    Markup markup;
-    RGBA color;
-    Border border;
-    uint8_t radius;
-    Padding padding;
-    std::string tag;
-};
-
-struct FlexContainer : public Renderable {
-    FlexContainer() : Renderable(), isColumn(false), padding({}) {}
-    void Compute(cairo_t* cr) override;
-    void Draw(cairo_t* cr, int x, int y, std::vector<Target>& targets) const override;
-
-    bool isColumn;
-    Padding padding;
-    std::vector<std::unique_ptr<Renderable>> children;
-    std::string tag;
-};
-
 struct WidgetConfig {
     WidgetConfig() : padding({}) {}
-    std::function<std::unique_ptr<Renderable>(const std::string& outputName)> render;
+    // Fills the cleared tree, returns false when rendering failed
+    std::function<bool(const std::string& outputName, RenderTree& tree)> render;
     std::function<void(std::string_view tag)> click;
     std::function<void(std::string_view tag, int value)> wheel;
+    // Invoked with the tag under the pointer when it changes, empty when the pointer leaves
+    std::function<void(std::string_view tag)> hover;
     std::set<std::string> sources;
     Padding padding;
 };
 
+struct SurfaceDeleter {
+    void operator()(cairo_surface_t* surface) const { cairo_surface_destroy(surface); }
+};
+
 struct Widget {
-    Widget() : computed({}), m_renderable(nullptr), m_paddingX(0), m_paddingY(0) {}
-    void Compute(const WidgetConfig& config, const std::string& outputName, cairo_t* cr);
-    void Draw(cairo_t* cr, int x, int y, std::vector<Target>& targets) const;
+    Widget()
+        : computed({}),
+          renderedAt(0),
+          m_hasTree(false),
+          m_padding({}),
+          m_isComputed(false),
+          m_paddingX(0),
+          m_paddingY(0),
+          m_hash(0),
+          m_tileHash(0),
+          m_hoveredAt(0) {}
+    // Creates the render tree by calling Lua, only on main thread
+    void Render(const WidgetConfig& config, const std::string& outputName);
+    // Computes size of render tree, the tree is not changed by Lua after render so this and
+    // drawing can be done on any thread.
+    void Compute(cairo_t* cr);
+    bool IsComputed() const { return m_isComputed; }
+    // Hash of rendered tree, available before computed
+    size_t TreeHash() const;
+    // Rasterizes the render tree into a tile if the tree changed since last draw, the tile is
+    // then copied to cr.
+    void Draw(cairo_t* cr, int x, int y, std::vector<Target>& targets);
+    // Targets tagged with tag are drawn with their hover style instead of targets tagged with the
+    // previous tag. Only the parts of the tile covered by those targets are rasterized again,
+    // they are damaged in frame. Returns true when the widget needs to be drawn again.
+    bool SetHover(std::string_view tag, uint64_t frame);
+    // Frame where hover last changed and what changed, relative to the widget
+    uint64_t HoveredAt() const { return m_hoveredAt; }
+    const std::vector<Rect>& HoverDamage() const { return m_hoverDamage; }
     Size computed;
+    // Frame number when rendered, 0 when never rendered
+    uint64_t renderedAt;
 
    private:
-    std::unique_ptr<Renderable> m_renderable;
+    // Storage of the tree is reused between renders
+    RenderTree m_tree;
+    bool m_hasTree;
+    Padding m_padding;
+    bool m_isComputed;
     int m_paddingX;
     int m_paddingY;
+    // Hash of current render tree and of the tree in the tile
+    size_t m_hash;
+    size_t m_tileHash;
+    std::unique_ptr<cairo_surface_t, SurfaceDeleter> m_tile;
+    // Relative to the tile
+    std::vector<Target> m_tileTargets;
+    std::string m_hover;
+    uint64_t m_hoveredAt;
+    std::vector<Rect> m_hoverDamage;
 };
 
 struct PanelConfig {
@@ -124,6 +86,9 @@ struct PanelConfig {
     Anchor anchor;
     bool isColumn;
     std::function<bool(const std::string& outputName)> checkDisplay;
+    // Each widget is drawn in a subsurface of its own, updating one widget does not commit the
+    // whole panel.
+    bool subsurfaces;
 };
 
 enum class Compositor {
@@ -148,7 +113,10 @@ class Configuration {
     PanelConfig alertPanel;
     DisplaysConfig displays;
     AudioConfig audio;
-    int bufferWidth;
-    int bufferHeight;
-    int numBuffers;
+    // Keep panels rendered while hidden to show them faster
+    bool prerender;
+    // Draw all panels of an output in one shared buffer instead of buffers per panel
+    bool atlas;
+    // Pango font descriptions to load at startup
+    std::vector<std::string> fonts;
 };
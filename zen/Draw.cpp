@@ -1,188 +1,191 @@
 #include "zen/Draw.h"
 
-#include "pango/pango-layout.h"
-#include "pango/pangocairo.h"
-#include "spdlog/spdlog.h"
-
-static void LogComputed(const Size& computed, const char* s) {
-    spdlog::trace("Computed {}: {}x{}", s, computed.cx, computed.cy);
-}
-
-static void LogDraw(const char* s, int x, int y) { spdlog::trace("Draw {}: {},{}", s, x, y); }
-
-void Markup::Compute(cairo_t* cr) {
-    // pango_layout_set_width(m_layout, m_config.cx * PANGO_SCALE);
-    // pango_layout_set_height(m_layout, m_config.cy * PANGO_SCALE);
-    m_layout = pango_cairo_create_layout(cr);
-    pango_layout_set_markup(m_layout, string.c_str(), -1);
-    PangoRectangle rect;
-    pango_layout_get_extents(m_layout, nullptr, &rect);
-    pango_extents_to_pixels(&rect, nullptr);
-    computed.cx = rect.width;
-    computed.cy = rect.height;
-    LogComputed(computed, ("Markup " + string).c_str());
-}
-
-void Markup::Draw(cairo_t* cr, int x, int y, std::vector<Target>&) const {
-    LogDraw("Markup", x, y);
-    cairo_move_to(cr, x, y);
-    pango_cairo_show_layout(cr, m_layout);
-}
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <utility>
 
-static void BeginRectangleSubPath(cairo_t* cr, int x, int y, int cx, int cy, int radius) {
-    constexpr double degrees = M_PI / 180.0;
-    cairo_new_sub_path(cr);
-    // A-----B
-    // |     |
-    // C-----D
-    // B
-    cairo_arc(cr, x + cx - radius, y + radius, radius, -90 * degrees, 0 * degrees);
-    // D
-    cairo_arc(cr, x + cx - radius, y + cy - radius, radius, 0 * degrees, 90 * degrees);
-    // C
-    cairo_arc(cr, x + radius, y + cy - radius, radius, 90 * degrees, 180 * degrees);
-    // A
-    cairo_arc(cr, x + radius, y + radius, radius, 180 * degrees, 270 * degrees);
-    cairo_close_path(cr);
-}
+#include "spdlog/spdlog.h"
+#include "zen/LayoutCache.h"
 
-void MarkupBox::Compute(cairo_t* cr) {
-    markup.Compute(cr);
-    computed = markup.computed;
-    computed.cx += padding.left + padding.right + (2 * border.width);
-    computed.cy += padding.top + padding.bottom + (2 * border.width);
-    LogComputed(computed, "MarkupBox ");
+static void HashPadding(size_t& hash, const Padding& padding) {
+    HashCombine(hash, padding.left);
+    HashCombine(hash, padding.right);
+    HashCombine(hash, padding.top);
+    HashCombine(hash, padding.bottom);
 }
 
-void MarkupBox::Draw(cairo_t* cr, int x, int y, std::vector<Target>& targets) const {
-    LogDraw("MarkupBox", x, y);
-    BeginRectangleSubPath(cr, x + border.width, y + border.width, computed.cx - (2 * border.width),
-                          computed.cy - (2 * border.width), radius);
-    // Border
-    if (border.width) {
-        // Cairo draws lines with half of the line width within the edge and the
-        // other half outside. We want everything on the outside.
-        cairo_push_group_with_content(cr, CAIRO_CONTENT_ALPHA);
-        cairo_set_line_width(cr, border.width * 2.0);
-        cairo_set_source_rgba(cr, 0, 0, 0, 1);
-        cairo_set_operator(cr, CAIRO_OPERATOR_SOURCE);
-        cairo_stroke_preserve(cr);
-        cairo_set_operator(cr, CAIRO_OPERATOR_CLEAR);
-        cairo_fill_preserve(cr);
-        auto mask = cairo_pop_group(cr);
-        cairo_set_source_rgba(cr, border.color.r, border.color.g, border.color.b, border.color.a);
-        cairo_mask(cr, mask);
-        cairo_pattern_destroy(mask);
-    }
-    // Fill
-    cairo_set_source_rgba(cr, color.r, color.g, color.b, color.a);
-    cairo_fill(cr);
-    // Inner
-    markup.Draw(cr, x + padding.left + border.width, y + padding.top + border.width, targets);
-    if (tag != "") {
-        targets.push_back(Target{
-            .position = Rect{.x = x, .y = y, .cx = computed.cx, .cy = computed.cy}, .tag = tag});
+void Widget::Render(const WidgetConfig& config, const std::string& outputName) {
+    m_tree.Clear();
+    m_hasTree = config.render(outputName, m_tree);
+    m_tree.HashNodes();
+    m_padding = config.padding;
+    m_isComputed = false;
+    if (!m_hasTree) {
+        spdlog::error("Bad render return from widget");
     }
+    spdlog::trace("Rendered tree of {} nodes", m_tree.NumNodes());
 }
 
-void FlexContainer::Compute(cairo_t* cr) {
-    computed.cx = 0;
-    computed.cy = 0;
-    for (const auto& r : children) {
-        r->Compute(cr);
-        if (isColumn) {
-            computed.cy += padding.top + padding.bottom + r->computed.cy;
-            computed.cx = std::max(computed.cx, r->computed.cx + padding.left + padding.right);
-        } else {
-            computed.cx += padding.left + padding.right + r->computed.cx;
-            computed.cy = std::max(computed.cy, r->computed.cy + padding.top + padding.bottom);
-        }
+size_t Widget::TreeHash() const {
+    if (!m_hasTree) {
+        return 0;
     }
-    LogComputed(computed, "FlexContainer");
-}
-
-void FlexContainer::Draw(cairo_t* cr, int x, int y, std::vector<Target>& targets) const {
-    LogDraw("FlexBox", x, y);
-    const int startx = x;
-    const int starty = y;
-    if (isColumn) {
-        for (const auto& r : children) {
-            y += padding.top;
-            r->Draw(cr, x + padding.left, y, targets);
-            y += r->computed.cy + padding.bottom;
-        }
-    } else {
-        y += padding.top;
-        for (const auto& r : children) {
-            x += padding.left;
-            r->Draw(cr, x, y, targets);
-            x += r->computed.cx + padding.right;
-        }
-        y += padding.bottom;
-    }
-    if (tag != "") {
-        targets.push_back(
-            Target{.position = Rect{.x = startx, .y = starty, .cx = computed.cx, .cy = computed.cy},
-                   .tag = tag});
+    auto hash = m_tree.Hash();
+    HashPadding(hash, m_padding);
+    if (!m_hover.empty()) {
+        HashCombine(hash, std::hash<std::string>{}(m_hover));
     }
+    return hash;
 }
 
-void Widget::Compute(const WidgetConfig& config, const std::string& outputName, cairo_t* cr) {
-    auto item = config.render(outputName);
-    if (!item) {
-        spdlog::error("Bad render return from widget");
+void Widget::Compute(cairo_t* cr) {
+    m_isComputed = true;
+    if (!m_hasTree) {
         m_paddingX = 0;
         m_paddingY = 0;
         computed.cx = 0;
         computed.cy = 0;
         return;
     }
-    item->Compute(cr);
-    m_paddingX = config.padding.left;
-    m_paddingY = config.padding.top;
-    computed.cx = item->computed.cx + config.padding.left + config.padding.right + m_paddingX;
-    computed.cy = item->computed.cy + config.padding.top + config.padding.bottom + m_paddingY;
-    m_renderable = std::move(item);
+    m_tree.Compute(cr);
+    m_paddingX = m_padding.left;
+    m_paddingY = m_padding.top;
+    const auto treeSize = m_tree.Computed();
+    computed.cx = treeSize.cx + m_padding.left + m_padding.right + m_paddingX;
+    computed.cy = treeSize.cy + m_padding.top + m_padding.bottom + m_paddingY;
+    m_hash = m_tree.Hash();
+    HashCombine(m_hash, m_paddingX);
+    HashCombine(m_hash, m_paddingY);
+    HashCombine(m_hash, computed.cx);
+    HashCombine(m_hash, computed.cy);
 }
 
-void Widget::Draw(cairo_t* cr, int x, int y, std::vector<Target>& targets) const {
-    if (!m_renderable) {
-        // Lua render failed previously
+void Widget::Draw(cairo_t* cr, int x, int y, std::vector<Target>& targets) {
+    if (!m_hasTree || computed.cx <= 0 || computed.cy <= 0) {
+        // Lua render failed previously or nothing to draw
         return;
     }
+    if (!m_tile || m_tileHash != m_hash) {
+        // Render tree changed, rasterize it
+        const auto start = std::chrono::steady_clock::now();
+        m_tile.reset(cairo_image_surface_create(CAIRO_FORMAT_ARGB32, computed.cx, computed.cy));
+        auto tileCr = cairo_create(m_tile.get());
+        m_tileTargets.clear();
+        m_tree.Draw(tileCr, m_paddingX, m_paddingY, m_hover, m_tileTargets);
+        cairo_destroy(tileCr);
+        cairo_surface_flush(m_tile.get());
+        m_tileHash = m_hash;
+        const auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - start);
+        spdlog::trace("Rasterized widget tile {}x{} in {}us", computed.cx, computed.cy,
+                      elapsed.count());
+    }
+    // Area of widget is cleared, just copy the tile
     cairo_save(cr);
-    m_renderable->Draw(cr, x + m_paddingX, y + m_paddingY, targets);
+    cairo_set_operator(cr, CAIRO_OPERATOR_SOURCE);
+    cairo_set_source_surface(cr, m_tile.get(), x, y);
+    cairo_rectangle(cr, x, y, computed.cx, computed.cy);
+    cairo_fill(cr);
     cairo_restore(cr);
+    for (auto target : m_tileTargets) {
+        target.position.x += x;
+        target.position.y += y;
+        targets.push_back(std::move(target));
+    }
+}
+
+bool Widget::SetHover(std::string_view tag, uint64_t frame) {
+    if (tag == m_hover) {
+        return false;
+    }
+    // Hover styles are looked up before the previous tag is replaced
+    const bool isStyled = m_tree.HasHoverStyle(m_hover) || m_tree.HasHoverStyle(tag);
+    const std::string previous = std::exchange(m_hover, std::string(tag));
+    if (!isStyled) {
+        return false;
+    }
+    if (m_hoveredAt != frame) {
+        m_hoverDamage.clear();
+        m_hoveredAt = frame;
+    }
+    if (!m_tile || m_tileHash != m_hash) {
+        // Rasterized with the new hover state when drawn
+        m_hoverDamage.push_back(Rect{0, 0, computed.cx, computed.cy});
+        return true;
+    }
+    const auto start = std::chrono::steady_clock::now();
+    thread_local std::vector<Target> targets;
+    auto tileCr = cairo_create(m_tile.get());
+    for (const auto& target : m_tileTargets) {
+        if (target.tag.empty() || (target.tag != previous && target.tag != m_hover)) {
+            continue;
+        }
+        const auto& rect = target.position;
+        cairo_save(tileCr);
+        cairo_rectangle(tileCr, rect.x, rect.y, rect.cx, rect.cy);
+        cairo_clip(tileCr);
+        cairo_set_operator(tileCr, CAIRO_OPERATOR_CLEAR);
+        cairo_paint(tileCr);
+        cairo_set_operator(tileCr, CAIRO_OPERATOR_OVER);
+        targets.clear();
+        m_tree.Draw(tileCr, m_paddingX, m_paddingY, m_hover, targets);
+        cairo_restore(tileCr);
+        m_hoverDamage.push_back(rect);
+    }
+    cairo_destroy(tileCr);
+    cairo_surface_flush(m_tile.get());
+    const auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - start);
+    spdlog::trace("Rasterized {} hovered targets in {}us", m_hoverDamage.size(), elapsed.count());
+    return true;
 }
 
 enum class Align { Left, Right, Top, Bottom, CenterX, CenterY };
 
-bool Draw::Panel(const PanelConfig& panelConfig, const std::string& outputName,
-                 BufferPool& bufferPool, DrawnPanel& drawn) {
-    // Get free buffer to draw in. This could fail if both buffers are locked.
-    auto buffer = bufferPool.Get();
-    if (!buffer) {
-        spdlog::error("No buffer to draw in");
-        return false;
+// Layouts are computed before there is a buffer to draw in, the size of the buffer
+// depends on the computed size. One per thread.
+static cairo_t* MeasureContext() {
+    thread_local cairo_surface_t* surface = cairo_image_surface_create(CAIRO_FORMAT_ARGB32, 1, 1);
+    thread_local cairo_t* cr = cairo_create(surface);
+    return cr;
+}
+
+void Draw::Render(const PanelConfig& panelConfig, const std::string& outputName, uint64_t frame,
+                  const std::vector<uint64_t>& changedAt, std::vector<Widget>& widgets) {
+    widgets.resize(panelConfig.widgets.size());
+    for (size_t i = 0; i < widgets.size(); i++) {
+        auto& widget = widgets[i];
+        if (widget.renderedAt < changedAt[i]) {
+            widget.Render(panelConfig.widgets[i], outputName);
+            widget.renderedAt = frame;
+        }
     }
-    // Clear buffer
-    // TODO: Could delay this to only clear part that will be used when drawing
-    auto cr = buffer->GetCairoCtx();
-    buffer->Clear(0x00);
-    // Calculate size of all widgets and track max width and height
-    auto widgets = std::vector<Widget>(panelConfig.widgets.size());
+}
+
+Size Draw::Layout(const PanelConfig& panelConfig, std::vector<Widget>& widgets,
+                  std::vector<Rect>& rects) {
+    auto cr = MeasureContext();
+    // Calculate size of changed widgets and track max width and height
     int maxCx = 0, maxCy = 0;
     int cx = 0, cy = 0;
+    int numComputed = 0;
     for (size_t i = 0; i < widgets.size(); i++) {
         auto& widget = widgets[i];
-        auto& config = panelConfig.widgets[i];
-        widget.Compute(config, outputName, cr);
+        if (!widget.IsComputed()) {
+            widget.Compute(cr);
+            numComputed++;
+        }
         maxCx = std::max(maxCx, widget.computed.cx);
         maxCy = std::max(maxCy, widget.computed.cy);
         cx += widget.computed.cx;
         cy += widget.computed.cy;
     }
-    std::vector<Target> targets;
+    if (numComputed > 0) {
+        const auto& stats = LayoutCache::ForThread().GetStats();
+        spdlog::debug("Computed {} of {} widgets, layout cache hits {}, misses {}, evictions {}",
+                      numComputed, widgets.size(), stats.hits, stats.misses, stats.evictions);
+    }
     Align align = Align::CenterX;
     int xfac = 0, yfac = 0;
     if (panelConfig.isColumn) {
@@ -226,7 +229,8 @@ bool Draw::Panel(const PanelConfig& panelConfig, const std::string& outputName,
                 break;
         }
     }
-    // Draw to buffer
+    // Position of every widget
+    rects.clear();
     int x = 0, y = 0;
     for (const auto& widget : widgets) {
         switch (align) {
@@ -247,13 +251,122 @@ bool Draw::Panel(const PanelConfig& panelConfig, const std::string& outputName,
                 y = (maxCy - widget.computed.cy) / 2;
                 break;
         }
-        widget.Draw(cr, x, y, targets);
-        drawn.widgets.push_back(
-            DrawnWidget{.position = {x, y, widget.computed.cx, widget.computed.cy},
-                        .targets = std::move(targets)});
+        rects.push_back(Rect{x, y, widget.computed.cx, widget.computed.cy});
         x += widget.computed.cx * xfac;
         y += widget.computed.cy * yfac;
     }
+    return Size{cx, cy};
+}
+
+bool Draw::Panel(const PanelConfig& panelConfig, BufferPool& bufferPool, uint64_t frame,
+                 const std::vector<uint64_t>& changedAt, std::vector<Widget>& widgets,
+                 DrawnPanel& drawn) {
+    // Scratch storage is kept per thread to avoid allocating in every frame
+    thread_local std::vector<Rect> rects;
+    thread_local std::vector<bool> repaint;
+    const auto [cx, cy] = Layout(panelConfig, widgets, rects);
+    // Get free buffer of the right size to draw in. This could fail if all buffers are locked.
+    auto buffer = bufferPool.Get(cx, cy);
+    if (!buffer) {
+        spdlog::debug("No buffer to draw in");
+        return false;
+    }
+    // The buffer contains what was drawn in an earlier frame, only widgets that changed since
+    // then or that moved needs to be repainted.
+    const auto& bufferRects = buffer->WidgetRects();
+    const bool hasPrevious = drawn.widgets.size() == rects.size();
+    const bool isFull = buffer->Frame() == 0 || bufferRects.size() != rects.size() || !hasPrevious;
+    repaint.assign(widgets.size(), true);
+    // Damage of previous frame is not needed anymore
+    auto& damage = drawn.damage;
+    damage.clear();
+    if (isFull) {
+        buffer->Clear(0x00);
+    }
+    for (size_t i = 0; i < widgets.size(); i++) {
+        const auto& rect = rects[i];
+        // Damage what changed since previous frame
+        if (hasPrevious && (changedAt[i] == frame || drawn.widgets[i].position != rect)) {
+            damage.push_back(drawn.widgets[i].position);
+            damage.push_back(rect);
+        } else if (hasPrevious && widgets[i].HoveredAt() == frame) {
+            // Only targets that changed hover state
+            for (auto hoverDamage : widgets[i].HoverDamage()) {
+                hoverDamage.x += rect.x;
+                hoverDamage.y += rect.y;
+                damage.push_back(hoverDamage);
+            }
+        }
+        if (isFull) {
+            continue;
+        }
+        // Widget is copied from the tile again when hover changed since the buffer was drawn
+        repaint[i] = changedAt[i] > buffer->Frame() || widgets[i].HoveredAt() > buffer->Frame() ||
+                     bufferRects[i] != rect;
+        if (repaint[i]) {
+            // Clear all before painting anything, old rect of one widget might overlap new rect
+            // of another.
+            buffer->ClearRect(bufferRects[i]);
+            buffer->ClearRect(rect);
+        }
+    }
+    auto cr = buffer->GetCairoCtx();
+    // Drawn widgets are updated in place
+    drawn.widgets.resize(widgets.size());
+    for (size_t i = 0; i < widgets.size(); i++) {
+        const auto& rect = rects[i];
+        auto& drawnWidget = drawn.widgets[i];
+        if (!repaint[i]) {
+            // Buffer is up to date for this widget, targets are the same as in previous frame
+            // but might have been at another position.
+            for (auto& target : drawnWidget.targets) {
+                target.position.x += rect.x - drawnWidget.position.x;
+                target.position.y += rect.y - drawnWidget.position.y;
+            }
+            drawnWidget.position = rect;
+            continue;
+        }
+        // Keep widgets from painting outside of their area
+        drawnWidget.position = rect;
+        drawnWidget.targets.clear();
+        cairo_save(cr);
+        cairo_rectangle(cr, rect.x, rect.y, rect.cx, rect.cy);
+        cairo_clip(cr);
+        widgets[i].Draw(cr, rect.x, rect.y, drawnWidget.targets);
+        cairo_restore(cr);
+    }
+    spdlog::trace("Repainted {} of {} widgets", std::count(repaint.begin(), repaint.end(), true),
+                  widgets.size());
+    // Surface needs to be damaged entirely when the size changes or nothing is known about
+    // previous frame.
+    if (!hasPrevious || drawn.size.cx != cx || drawn.size.cy != cy) {
+        damage.clear();
+        damage.push_back(Rect{0, 0, std::max(cx, drawn.size.cx), std::max(cy, drawn.size.cy)});
+    }
+    buffer->SetContent(frame, rects);
+    drawn.size = Size{cx, cy};
+    drawn.buffer = buffer;
+    return true;
+}
+
+bool Draw::SingleWidget(Widget& widget, BufferPool& bufferPool, uint64_t frame,
+                        DrawnPanel& drawn) {
+    const auto [cx, cy] = widget.computed;
+    auto buffer = bufferPool.Get(cx, cy);
+    if (!buffer) {
+        spdlog::debug("No buffer to draw widget in");
+        return false;
+    }
+    buffer->Clear(0x00);
+    drawn.widgets.resize(1);
+    auto& drawnWidget = drawn.widgets[0];
+    drawnWidget.position = Rect{0, 0, cx, cy};
+    drawnWidget.targets.clear();
+    widget.Draw(buffer->GetCairoCtx(), 0, 0, drawnWidget.targets);
+    // Buffers are not reused for another frame, everything is damaged
+    drawn.damage.clear();
+    drawn.damage.push_back(Rect{0, 0, std::max(cx, 1), std::max(cy, 1)});
+    buffer->SetContent(frame, {});
     drawn.size = Size{cx, cy};
     drawn.buffer = buffer;
     return true;
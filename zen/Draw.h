@@ -18,9 +18,30 @@ struct DrawnPanel {
     std::shared_ptr<Buffer> buffer;
     Size size;
     std::vector<DrawnWidget> widgets;
+    // Parts of the panel that differs from the previously drawn panel
+    std::vector<Rect> damage;
 };
 
 struct Draw {
-    static bool Panel(const PanelConfig& panelConfig, const std::string& outputName,
-                      BufferPool& bufferPool, DrawnPanel& drawn);
+    // Renders widgets that changed since they were rendered, changedAt is the frame number where
+    // each widget last changed. Calls into Lua and must be done on the main thread.
+    static void Render(const PanelConfig& panelConfig, const std::string& outputName,
+                       uint64_t frame, const std::vector<uint64_t>& changedAt,
+                       std::vector<Widget>& widgets);
+    // Draws rendered widgets as frame number frame. Each widget is only repainted when it has
+    // changed since the frame that the buffer contains. Widgets are kept between frames and only
+    // computed again when rendered. Drawn should contain the previous frame when called.
+    // Does not touch Lua or Wayland and can be done on any thread as long as the same panel is
+    // not drawn by multiple threads.
+    static bool Panel(const PanelConfig& panelConfig, BufferPool& bufferPool, uint64_t frame,
+                      const std::vector<uint64_t>& changedAt, std::vector<Widget>& widgets,
+                      DrawnPanel& drawn);
+    // Computes widgets that are not computed and positions them within the panel, returns the
+    // size of the panel. Can be done on any thread, same as Panel.
+    static Size Layout(const PanelConfig& panelConfig, std::vector<Widget>& widgets,
+                       std::vector<Rect>& rects);
+    // Draws a single widget in a buffer of its own, used when the widget has a surface of its
+    // own.
+    static bool SingleWidget(Widget& widget, BufferPool& bufferPool, uint64_t frame,
+                             DrawnPanel& drawn);
 };
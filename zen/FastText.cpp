@@ -0,0 +1,542 @@
+#include "zen/FastText.h"
+
+#include <spdlog/spdlog.h>
+
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <cstdlib>
+
+#include "pango/pangocairo.h"
+#include "zen/BlendMask.h"
+
+static constexpr int atlasSize = 1024;
+static constexpr size_t maxTexts = 512;
+static constexpr size_t maxRuns = 2048;
+
+ShapedText::~ShapedText() {
+    for (auto font : fonts) {
+        g_object_unref(font);
+    }
+}
+
+std::unique_ptr<FastText> FastText::Create() {
+    auto atlas = cairo_image_surface_create(CAIRO_FORMAT_A8, atlasSize, atlasSize);
+    if (cairo_surface_status(atlas) != CAIRO_STATUS_SUCCESS) {
+        spdlog::error("Failed to create glyph atlas");
+        cairo_surface_destroy(atlas);
+        return nullptr;
+    }
+    return std::unique_ptr<FastText>(new FastText(atlas, cairo_create(atlas)));
+}
+
+FastText& FastText::ForThread() {
+    thread_local auto fastText = FastText::Create();
+    return *fastText;
+}
+
+FastText::~FastText() {
+    m_textMap.clear();
+    m_texts.clear();
+    ResetAtlas();
+    for (auto& entry : m_fonts) {
+        g_object_unref(entry.second.font);
+    }
+    if (m_context) g_object_unref(m_context);
+    cairo_destroy(m_atlasCr);
+    cairo_surface_destroy(m_atlas);
+}
+
+static int HexDigit(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+static bool ParseColor(const std::string& value, RGBA& color) {
+    if ((value.length() != 7 && value.length() != 9) || value[0] != '#') {
+        return false;
+    }
+    for (size_t i = 1; i < value.length(); i++) {
+        if (HexDigit(value[i]) < 0) return false;
+    }
+    color = RGBA::FromString(value);
+    return true;
+}
+
+// Parses size like values, either in points ("10pt") or in Pango units ("10240")
+static bool ParseUnits(const std::string& value, bool allowNegative, int& units) {
+    if (value.ends_with("pt")) {
+        auto points = value.substr(0, value.length() - 2);
+        char* end = nullptr;
+        double d = std::strtod(points.c_str(), &end);
+        if (points.empty() || end != points.c_str() + points.length()) return false;
+        units = std::lround(d * PANGO_SCALE);
+    } else {
+        auto end = value.data() + value.length();
+        auto [ptr, ec] = std::from_chars(value.data(), end, units);
+        if (ec != std::errc() || ptr != end) return false;
+    }
+    return allowNegative || units > 0;
+}
+
+bool FastText::ApplyAttribute(const std::string& name, const std::string& value,
+                              Attributes& attributes) {
+    if (name == "font" || name == "font_desc") {
+        attributes.font = value;
+        return true;
+    }
+    if (name == "font_family" || name == "face") {
+        attributes.family = value;
+        return true;
+    }
+    if (name == "size") {
+        return ParseUnits(value, false, attributes.size);
+    }
+    if (name == "rise") {
+        return ParseUnits(value, true, attributes.rise);
+    }
+    if (name == "color" || name == "foreground" || name == "fgcolor") {
+        attributes.hasColor = ParseColor(value, attributes.color);
+        return attributes.hasColor;
+    }
+    return false;
+}
+
+static bool AppendEntity(std::string_view entity, std::string& text) {
+    if (entity == "amp") {
+        text += '&';
+    } else if (entity == "lt") {
+        text += '<';
+    } else if (entity == "gt") {
+        text += '>';
+    } else if (entity == "quot") {
+        text += '"';
+    } else if (entity == "apos") {
+        text += '\'';
+    } else {
+        // Only plain ASCII character references, anything else is left to Pango
+        if (entity.length() < 2 || entity[0] != '#') return false;
+        int c = 0;
+        auto end = entity.data() + entity.length();
+        auto [ptr, ec] = std::from_chars(entity.data() + 1, end, c);
+        if (ec != std::errc() || ptr != end || c < 0x20 || c > 0x7e) return false;
+        text += (char)c;
+    }
+    return true;
+}
+
+bool FastText::Parse(std::string_view markup, std::vector<Run>& runs) {
+    runs.clear();
+    std::vector<Attributes> stack{Attributes{}};
+    std::string text;
+    auto flush = [&runs, &stack, &text]() {
+        if (text.empty()) return;
+        runs.push_back({.text = std::move(text), .attributes = stack.back()});
+        text.clear();
+    };
+    size_t i = 0;
+    while (i < markup.length()) {
+        auto c = markup[i];
+        if (c == '&') {
+            auto end = markup.find(';', i);
+            if (end == std::string_view::npos) return false;
+            if (!AppendEntity(markup.substr(i + 1, end - i - 1), text)) return false;
+            i = end + 1;
+            continue;
+        }
+        if (c != '<') {
+            text += c;
+            i++;
+            continue;
+        }
+        flush();
+        auto tag = markup.substr(i);
+        if (tag.starts_with("</span>")) {
+            if (stack.size() == 1) return false;
+            stack.pop_back();
+            i += 7;
+            continue;
+        }
+        if (!tag.starts_with("<span") || tag.length() < 6 || (tag[5] != ' ' && tag[5] != '>')) {
+            return false;
+        }
+        i += 5;
+        auto attributes = stack.back();
+        while (true) {
+            while (i < markup.length() && markup[i] == ' ') i++;
+            if (i >= markup.length()) return false;
+            if (markup[i] == '>') {
+                i++;
+                break;
+            }
+            auto equals = markup.find('=', i);
+            if (equals == std::string_view::npos || equals + 1 >= markup.length()) return false;
+            auto quote = markup[equals + 1];
+            if (quote != '"' && quote != '\'') return false;
+            auto end = markup.find(quote, equals + 2);
+            if (end == std::string_view::npos) return false;
+            auto name = std::string(markup.substr(i, equals - i));
+            auto value = std::string(markup.substr(equals + 2, end - equals - 2));
+            if (!ApplyAttribute(name, value, attributes)) return false;
+            i = end + 1;
+        }
+        stack.push_back(std::move(attributes));
+    }
+    flush();
+    return stack.size() == 1 && !runs.empty();
+}
+
+std::shared_ptr<const ShapedText> FastText::Get(cairo_t* cr, std::string_view markup) {
+    double scaleX, scaleY;
+    cairo_surface_get_device_scale(cairo_get_target(cr), &scaleX, &scaleY);
+    if (scaleX != 1 || scaleY != 1) {
+        // Glyphs in the atlas are rasterized at scale 1
+        m_stats.fallbacks++;
+        return nullptr;
+    }
+    auto options = cairo_font_options_create();
+    cairo_get_font_options(cr, options);
+    auto fontOptions = cairo_font_options_hash(options);
+    cairo_font_options_destroy(options);
+    if (!m_context || fontOptions != m_fontOptions) {
+        // Shaping and rasterization depends on font options, start over
+        if (!m_context) m_context = pango_cairo_create_context(cr);
+        pango_cairo_update_context(cr, m_context);
+        m_textMap.clear();
+        m_texts.clear();
+        m_runs.clear();
+        ResetAtlas();
+        for (auto& entry : m_fonts) {
+            g_object_unref(entry.second.font);
+        }
+        m_fonts.clear();
+        m_fontOptions = fontOptions;
+    }
+
+    m_lookup.assign(markup);
+    auto it = m_textMap.find(m_lookup);
+    if (it != m_textMap.end()) {
+        m_stats.hits++;
+        // Move to front
+        m_texts.splice(m_texts.begin(), m_texts, it->second);
+        if (!it->second->second) m_stats.fallbacks++;
+        return it->second->second;
+    }
+    m_stats.misses++;
+    std::shared_ptr<ShapedText> text;
+    if (Parse(markup, m_scratchRuns)) {
+        text = Shape(m_scratchRuns);
+    }
+    if (!text) {
+        m_stats.fallbacks++;
+        spdlog::debug("Markup drawn with Pango: {}", m_lookup);
+    }
+    if (m_texts.size() >= maxTexts) {
+        m_textMap.erase(m_texts.back().first);
+        m_texts.pop_back();
+        m_stats.evictions++;
+    }
+    // Markup that can not be handled is remembered as well to avoid parsing it again
+    m_texts.emplace_front(m_lookup, text);
+    m_textMap[m_texts.front().first] = m_texts.begin();
+    spdlog::trace("Fast text miss, hits {}, misses {}, fallbacks {}, evictions {}, glyphs {}, "
+                  "atlas resets {}",
+                  m_stats.hits, m_stats.misses, m_stats.fallbacks, m_stats.evictions,
+                  m_stats.glyphs, m_stats.atlasResets);
+    return text;
+}
+
+const FastText::Font* FastText::LoadFont(const Attributes& attributes) {
+    auto key = attributes.font + '|' + attributes.family + '|' + std::to_string(attributes.size);
+    auto it = m_fonts.find(key);
+    if (it != m_fonts.end()) {
+        return &it->second;
+    }
+    auto desc = pango_font_description_copy(pango_context_get_font_description(m_context));
+    if (!attributes.font.empty()) {
+        auto fontDesc = pango_font_description_from_string(attributes.font.c_str());
+        pango_font_description_merge(desc, fontDesc, true);
+        pango_font_description_free(fontDesc);
+    }
+    if (!attributes.family.empty()) {
+        pango_font_description_set_family(desc, attributes.family.c_str());
+    }
+    if (attributes.size) {
+        pango_font_description_set_size(desc, attributes.size);
+    }
+    auto font = pango_font_map_load_font(pango_context_get_font_map(m_context), m_context, desc);
+    pango_font_description_free(desc);
+    if (!font) {
+        return nullptr;
+    }
+    auto metrics = pango_font_get_metrics(font, pango_context_get_language(m_context));
+    Font loaded{.font = font,
+                .ascent = pango_font_metrics_get_ascent(metrics),
+                .descent = pango_font_metrics_get_descent(metrics)};
+    pango_font_metrics_unref(metrics);
+    return &(m_fonts[key] = loaded);
+}
+
+// Scripts that are shaped the same without itemization or bidi
+static bool IsSimpleScript(GUnicodeScript script) {
+    switch (script) {
+        case G_UNICODE_SCRIPT_COMMON:
+        case G_UNICODE_SCRIPT_INHERITED:
+        case G_UNICODE_SCRIPT_LATIN:
+        case G_UNICODE_SCRIPT_GREEK:
+        case G_UNICODE_SCRIPT_CYRILLIC:
+            return true;
+        default:
+            return false;
+    }
+}
+
+const std::vector<FastText::ShapedGlyph>* FastText::ShapeRun(const Font& font,
+                                                              std::string_view text) {
+    auto key = std::to_string((uintptr_t)font.font) + '|' + std::string(text);
+    auto it = m_runs.find(key);
+    if (it != m_runs.end()) {
+        return &it->second;
+    }
+    auto script = PANGO_SCRIPT_COMMON;
+    for (auto p = text.data(); p < text.data() + text.length(); p = g_utf8_next_char(p)) {
+        auto c = g_utf8_get_char_validated(p, text.data() + text.length() - p);
+        if (c == (gunichar)-1 || c == (gunichar)-2 || c < 0x20) return nullptr;
+        auto unicodeScript = g_unichar_get_script(c);
+        if (!IsSimpleScript(unicodeScript)) return nullptr;
+        if (unicodeScript != G_UNICODE_SCRIPT_COMMON &&
+            unicodeScript != G_UNICODE_SCRIPT_INHERITED) {
+            script = (PangoScript)unicodeScript;
+        }
+    }
+    PangoAnalysis analysis{};
+    analysis.font = font.font;
+    analysis.level = 0;
+    analysis.gravity = PANGO_GRAVITY_SOUTH;
+    analysis.script = script;
+    analysis.language = pango_context_get_language(m_context);
+    auto glyphs = pango_glyph_string_new();
+    pango_shape(text.data(), text.length(), &analysis, glyphs);
+    std::vector<ShapedGlyph> shaped;
+    shaped.reserve(glyphs->num_glyphs);
+    for (int i = 0; i < glyphs->num_glyphs; i++) {
+        const auto& info = glyphs->glyphs[i];
+        if (info.glyph & PANGO_GLYPH_UNKNOWN_FLAG) {
+            // Needs font fallback
+            pango_glyph_string_free(glyphs);
+            return nullptr;
+        }
+        shaped.push_back({.glyph = info.glyph,
+                          .width = info.geometry.width,
+                          .xOffset = info.geometry.x_offset,
+                          .yOffset = info.geometry.y_offset});
+    }
+    pango_glyph_string_free(glyphs);
+    if (m_runs.size() >= maxRuns) {
+        m_runs.clear();
+    }
+    return &(m_runs[key] = std::move(shaped));
+}
+
+std::shared_ptr<ShapedText> FastText::Shape(const std::vector<Run>& runs) {
+    static const std::vector<ShapedGlyph> noGlyphs;
+    auto text = std::make_shared<ShapedText>();
+    // Positions in Pango units, glyph y is relative to baseline until the line is done
+    int x = 0;
+    int width = 0;
+    int lineTop = 0;
+    int ascent = 0;
+    int descent = 0;
+    bool hasExtents = false;
+    size_t lineStart = 0;
+    auto endLine = [&]() {
+        for (size_t i = lineStart; i < text->glyphs.size(); i++) {
+            text->glyphs[i].y = PANGO_PIXELS(lineTop + ascent + text->glyphs[i].y);
+        }
+        width = std::max(width, x);
+        lineTop += ascent + descent;
+        x = ascent = descent = 0;
+        hasExtents = false;
+        lineStart = text->glyphs.size();
+    };
+    for (const auto& run : runs) {
+        auto font = LoadFont(run.attributes);
+        if (!font) return nullptr;
+        if (std::find(text->fonts.begin(), text->fonts.end(), font->font) == text->fonts.end()) {
+            text->fonts.push_back((PangoFont*)g_object_ref(font->font));
+        }
+        std::string_view remaining = run.text;
+        while (true) {
+            auto newline = remaining.find('\n');
+            auto segment = remaining.substr(0, newline);
+            // Raised runs move their extents like Pango does, the line is the union of them
+            const int runAscent = font->ascent + run.attributes.rise;
+            const int runDescent = font->descent - run.attributes.rise;
+            ascent = hasExtents ? std::max(ascent, runAscent) : runAscent;
+            descent = hasExtents ? std::max(descent, runDescent) : runDescent;
+            hasExtents = true;
+            auto shaped = segment.empty() ? &noGlyphs : ShapeRun(*font, segment);
+            if (!shaped) return nullptr;
+            for (const auto& glyph : *shaped) {
+                text->glyphs.push_back({.font = font->font,
+                                        .glyph = glyph.glyph,
+                                        .x = PANGO_PIXELS(x + glyph.xOffset),
+                                        .y = glyph.yOffset - run.attributes.rise,
+                                        .hasColor = run.attributes.hasColor,
+                                        .color = run.attributes.color});
+                x += glyph.width;
+            }
+            if (newline == std::string_view::npos) break;
+            endLine();
+            remaining = remaining.substr(newline + 1);
+        }
+    }
+    endLine();
+    text->size = {.cx = (width + PANGO_SCALE - 1) / PANGO_SCALE,
+                  .cy = (lineTop + PANGO_SCALE - 1) / PANGO_SCALE};
+    return text;
+}
+
+void FastText::ResetAtlas() {
+    for (auto& entry : m_atlasGlyphs) {
+        g_object_unref(entry.first);
+    }
+    m_atlasGlyphs.clear();
+    m_shelfX = m_shelfY = m_shelfCy = 0;
+    cairo_save(m_atlasCr);
+    cairo_set_operator(m_atlasCr, CAIRO_OPERATOR_CLEAR);
+    cairo_paint(m_atlasCr);
+    cairo_restore(m_atlasCr);
+    cairo_surface_flush(m_atlas);
+}
+
+const FastText::AtlasGlyph* FastText::Rasterize(PangoFont* font, uint32_t glyph) {
+    auto fontIt = m_atlasGlyphs.find(font);
+    if (fontIt != m_atlasGlyphs.end()) {
+        auto it = fontIt->second.find(glyph);
+        if (it != fontIt->second.end()) {
+            return it->second.cx ? &it->second : nullptr;
+        }
+    }
+    AtlasGlyph atlasGlyph{};
+    auto scaledFont = pango_cairo_font_get_scaled_font(PANGO_CAIRO_FONT(font));
+    cairo_glyph_t cairoGlyph{.index = glyph, .x = 0, .y = 0};
+    cairo_text_extents_t extents{};
+    if (scaledFont && glyph != PANGO_GLYPH_EMPTY) {
+        cairo_scaled_font_glyph_extents(scaledFont, &cairoGlyph, 1, &extents);
+    }
+    if (extents.width > 0 && extents.height > 0) {
+        // One pixel of margin to fit antialiasing
+        atlasGlyph.left = std::floor(extents.x_bearing) - 1;
+        atlasGlyph.top = std::floor(extents.y_bearing) - 1;
+        atlasGlyph.cx = std::ceil(extents.x_bearing + extents.width) + 1 - atlasGlyph.left;
+        atlasGlyph.cy = std::ceil(extents.y_bearing + extents.height) + 1 - atlasGlyph.top;
+        if (atlasGlyph.cx > atlasSize || atlasGlyph.cy > atlasSize) {
+            atlasGlyph = {};
+        }
+    }
+    if (atlasGlyph.cx) {
+        if (m_shelfX + atlasGlyph.cx > atlasSize) {
+            m_shelfY += m_shelfCy;
+            m_shelfX = m_shelfCy = 0;
+        }
+        if (m_shelfY + atlasGlyph.cy > atlasSize) {
+            m_stats.atlasResets++;
+            spdlog::debug("Glyph atlas is full, resetting");
+            ResetAtlas();
+        }
+        atlasGlyph.x = m_shelfX;
+        atlasGlyph.y = m_shelfY;
+        m_shelfX += atlasGlyph.cx;
+        m_shelfCy = std::max(m_shelfCy, atlasGlyph.cy);
+        cairoGlyph.x = atlasGlyph.x - atlasGlyph.left;
+        cairoGlyph.y = atlasGlyph.y - atlasGlyph.top;
+        cairo_set_scaled_font(m_atlasCr, scaledFont);
+        cairo_show_glyphs(m_atlasCr, &cairoGlyph, 1);
+        cairo_surface_flush(m_atlas);
+        m_stats.glyphs++;
+    }
+    // Atlas might have been reset, look up font again
+    auto [it, isNewFont] = m_atlasGlyphs.try_emplace(font);
+    if (isNewFont) g_object_ref(font);
+    auto& stored = it->second[glyph] = atlasGlyph;
+    return stored.cx ? &stored : nullptr;
+}
+
+static void ToPixel(const RGBA& color, uint8_t pixel[4]) {
+    // Premultiplied, in memory order of little endian ARGB32
+    auto a = std::clamp(color.a, 0.0, 1.0);
+    pixel[0] = std::lround(std::clamp(color.b, 0.0, 1.0) * a * 255);
+    pixel[1] = std::lround(std::clamp(color.g, 0.0, 1.0) * a * 255);
+    pixel[2] = std::lround(std::clamp(color.r, 0.0, 1.0) * a * 255);
+    pixel[3] = std::lround(a * 255);
+}
+
+void FastText::Draw(cairo_t* cr, const ShapedText& text, int x, int y) {
+    RGBA source{.r = 0, .g = 0, .b = 0, .a = 1};
+    if (cairo_pattern_get_rgba(cairo_get_source(cr), &source.r, &source.g, &source.b,
+                               &source.a) != CAIRO_STATUS_SUCCESS) {
+        source = {.r = 0, .g = 0, .b = 0, .a = 1};
+    }
+    auto target = cairo_get_target(cr);
+    cairo_matrix_t matrix;
+    cairo_get_matrix(cr, &matrix);
+    double offsetX, offsetY;
+    cairo_surface_get_device_offset(target, &offsetX, &offsetY);
+    auto translateX = matrix.x0 + offsetX;
+    auto translateY = matrix.y0 + offsetY;
+    bool isBlendable = cairo_surface_get_type(target) == CAIRO_SURFACE_TYPE_IMAGE &&
+                       cairo_image_surface_get_format(target) == CAIRO_FORMAT_ARGB32 &&
+                       matrix.xx == 1 && matrix.yy == 1 && matrix.xy == 0 && matrix.yx == 0 &&
+                       translateX == std::floor(translateX) && translateY == std::floor(translateY);
+    if (!isBlendable) {
+        // Let cairo transform and composite each glyph
+        for (const auto& glyph : text.glyphs) {
+            auto atlasGlyph = Rasterize(glyph.font, glyph.glyph);
+            if (!atlasGlyph) continue;
+            const auto& color = glyph.hasColor ? glyph.color : source;
+            auto left = x + glyph.x + atlasGlyph->left;
+            auto top = y + glyph.y + atlasGlyph->top;
+            cairo_save(cr);
+            cairo_rectangle(cr, left, top, atlasGlyph->cx, atlasGlyph->cy);
+            cairo_clip(cr);
+            cairo_set_source_rgba(cr, color.r, color.g, color.b, color.a);
+            cairo_mask_surface(cr, m_atlas, left - atlasGlyph->x, top - atlasGlyph->y);
+            cairo_restore(cr);
+        }
+        return;
+    }
+    // Clip in device pixels
+    double x1, y1, x2, y2;
+    cairo_clip_extents(cr, &x1, &y1, &x2, &y2);
+    auto clipLeft = std::max(0, (int)std::ceil(x1 + translateX));
+    auto clipTop = std::max(0, (int)std::ceil(y1 + translateY));
+    auto clipRight = std::min(cairo_image_surface_get_width(target), (int)(x2 + translateX));
+    auto clipBottom = std::min(cairo_image_surface_get_height(target), (int)(y2 + translateY));
+    cairo_surface_flush(target);
+    auto data = cairo_image_surface_get_data(target);
+    auto stride = cairo_image_surface_get_stride(target);
+    auto atlasData = cairo_image_surface_get_data(m_atlas);
+    auto atlasStride = cairo_image_surface_get_stride(m_atlas);
+    uint8_t sourcePixel[4];
+    ToPixel(source, sourcePixel);
+    uint8_t glyphPixel[4];
+    for (const auto& glyph : text.glyphs) {
+        auto atlasGlyph = Rasterize(glyph.font, glyph.glyph);
+        if (!atlasGlyph) continue;
+        auto left = (int)translateX + x + glyph.x + atlasGlyph->left;
+        auto top = (int)translateY + y + glyph.y + atlasGlyph->top;
+        auto l = std::max(left, clipLeft);
+        auto t = std::max(top, clipTop);
+        auto r = std::min(left + atlasGlyph->cx, clipRight);
+        auto b = std::min(top + atlasGlyph->cy, clipBottom);
+        if (r <= l || b <= t) continue;
+        if (glyph.hasColor) ToPixel(glyph.color, glyphPixel);
+        BlendMask(data + t * stride + l * 4, stride,
+                  atlasData + (atlasGlyph->y + t - top) * atlasStride + atlasGlyph->x + l - left,
+                  atlasStride, r - l, b - t, glyph.hasColor ? glyphPixel : sourcePixel);
+    }
+    cairo_surface_mark_dirty(target);
+}
@@ -0,0 +1,143 @@
+#pragma once
+
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "cairo.h"
+#include "pango/pango-layout.h"
+#include "zen/RenderTree.h"
+
+// Markup shaped once and positioned, drawn from a glyph atlas.
+struct ShapedText {
+    struct Glyph {
+        PangoFont* font;
+        uint32_t glyph;
+        // Position of glyph origin in pixels relative to top left of text
+        int x;
+        int y;
+        // Spans without color are drawn with the current source color
+        bool hasColor;
+        RGBA color;
+    };
+    ShapedText() : size{} {}
+    virtual ~ShapedText();
+    ShapedText(const ShapedText&) = delete;
+    ShapedText& operator=(const ShapedText&) = delete;
+
+    Size size;
+    std::vector<Glyph> glyphs;
+    // References to all fonts used by glyphs
+    std::vector<PangoFont*> fonts;
+};
+
+// Fast path for markup that only consists of text and spans with font, size, color and rise
+// attributes, which is what most widgets use. Runs are shaped once and rasterized glyphs are
+// kept in an atlas that is blended directly into image surfaces. Markup that needs anything
+// else, like other attributes, font fallback or scripts that needs itemization, should be drawn
+// with Pango layouts. One per thread, same as the layout cache.
+class FastText {
+   public:
+    struct Stats {
+        int hits;
+        int misses;
+        // Markup that could not be handled
+        int fallbacks;
+        int glyphs;
+        int atlasResets;
+        // Least recently used texts dropped to make room
+        int evictions;
+    };
+    struct Attributes {
+        std::string font;
+        std::string family;
+        // In Pango units, 0 when unset
+        int size;
+        int rise;
+        bool hasColor;
+        RGBA color;
+    };
+    struct Run {
+        std::string text;
+        Attributes attributes;
+    };
+
+    static std::unique_ptr<FastText> Create();
+    static FastText& ForThread();
+    virtual ~FastText();
+
+    // Returns null when the markup can not be handled
+    std::shared_ptr<const ShapedText> Get(cairo_t* cr, std::string_view markup);
+    // Draws text with top left at x, y
+    void Draw(cairo_t* cr, const ShapedText& text, int x, int y);
+    const Stats& GetStats() const { return m_stats; }
+    // Splits markup into runs of text with the same attributes, false when the markup has
+    // anything but text and spans with supported attributes.
+    static bool Parse(std::string_view markup, std::vector<Run>& runs);
+
+   private:
+    struct Font {
+        PangoFont* font;
+        int ascent;
+        int descent;
+    };
+    struct ShapedGlyph {
+        uint32_t glyph;
+        // Pango units
+        int width;
+        int xOffset;
+        int yOffset;
+    };
+    struct AtlasGlyph {
+        int x;
+        int y;
+        int cx;
+        int cy;
+        // Offset from glyph origin to top left of rasterized glyph
+        int left;
+        int top;
+    };
+    using TextEntry = std::pair<std::string, std::shared_ptr<ShapedText>>;
+    using TextEntries = std::list<TextEntry>;
+
+    FastText(cairo_surface_t* atlas, cairo_t* atlasCr)
+        : m_context(nullptr),
+          m_fontOptions(0),
+          m_atlas(atlas),
+          m_atlasCr(atlasCr),
+          m_shelfX(0),
+          m_shelfY(0),
+          m_shelfCy(0),
+          m_stats{} {}
+    static bool ApplyAttribute(const std::string& name, const std::string& value,
+                               Attributes& attributes);
+    std::shared_ptr<ShapedText> Shape(const std::vector<Run>& runs);
+    const Font* LoadFont(const Attributes& attributes);
+    const std::vector<ShapedGlyph>* ShapeRun(const Font& font, std::string_view text);
+    const AtlasGlyph* Rasterize(PangoFont* font, uint32_t glyph);
+    void ResetAtlas();
+
+    PangoContext* m_context;
+    unsigned long m_fontOptions;
+    // Most recently used first, null for markup that is drawn with Pango
+    TextEntries m_texts;
+    std::unordered_map<std::string, TextEntries::iterator> m_textMap;
+    std::string m_lookup;
+    std::vector<Run> m_scratchRuns;
+    // Fonts are few and kept for the lifetime of the cache
+    std::unordered_map<std::string, Font> m_fonts;
+    std::unordered_map<std::string, std::vector<ShapedGlyph>> m_runs;
+    // Coverage of rasterized glyphs, placed on shelves
+    cairo_surface_t* m_atlas;
+    cairo_t* m_atlasCr;
+    // Fonts are referenced while they have glyphs in the atlas
+    std::unordered_map<PangoFont*, std::unordered_map<uint32_t, AtlasGlyph>> m_atlasGlyphs;
+    int m_shelfX;
+    int m_shelfY;
+    int m_shelfCy;
+    Stats m_stats;
+};
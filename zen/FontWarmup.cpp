@@ -0,0 +1,88 @@
+#include "zen/FontWarmup.h"
+
+#include <spdlog/spdlog.h>
+
+#include <chrono>
+
+#include "pango/pangocairo.h"
+
+std::unique_ptr<FontWarmup> FontWarmup::Start(std::vector<std::string> fonts) {
+    auto warmup = std::unique_ptr<FontWarmup>(new FontWarmup());
+    warmup->m_thread = std::thread([warmup = warmup.get(), fonts = std::move(fonts)] {
+        warmup->Run(fonts);
+    });
+    return warmup;
+}
+
+FontWarmup::~FontWarmup() {
+    if (m_thread.joinable()) {
+        m_thread.join();
+    }
+    if (m_fontMap) {
+        g_object_unref(m_fontMap);
+    }
+}
+
+// Covers the glyphs of most status texts
+static const char *sample =
+    "0123456789:.,%-/ ABCDEFGHIJKLMNOPQRSTUVWXYZ abcdefghijklmnopqrstuvwxyz";
+
+void FontWarmup::Run(const std::vector<std::string> &fonts) {
+    auto start = std::chrono::steady_clock::now();
+    // Creating the first font map loads the fontconfig configuration and caches
+    m_fontMap = pango_cairo_font_map_new();
+    Warm(m_fontMap, fonts);
+    auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - start);
+    spdlog::debug("Warmed up {} fonts in {}us", fonts.size() + 1, elapsed.count());
+}
+
+void FontWarmup::WarmThread(const std::vector<std::string> &fonts) {
+    auto start = std::chrono::steady_clock::now();
+    Warm(pango_cairo_font_map_get_default(), fonts);
+    auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - start);
+    spdlog::debug("Warmed up {} fonts on worker thread in {}us", fonts.size() + 1,
+                  elapsed.count());
+}
+
+void FontWarmup::Warm(PangoFontMap *fontMap, const std::vector<std::string> &fonts) {
+    // Same kind of target as layouts are measured and drawn in
+    auto surface = cairo_image_surface_create(CAIRO_FORMAT_ARGB32, 1, 1);
+    auto cr = cairo_create(surface);
+    auto context = pango_font_map_create_context(fontMap);
+    pango_cairo_update_context(cr, context);
+    auto layout = pango_layout_new(context);
+    pango_layout_set_text(layout, sample, -1);
+    auto warm = [layout, cr](const PangoFontDescription *desc) {
+        pango_layout_set_font_description(layout, desc);
+        // Shapes the text, which loads the font, and rasterizes the glyphs
+        pango_layout_get_pixel_extents(layout, nullptr, nullptr);
+        pango_cairo_show_layout(cr, layout);
+    };
+    // Default font first, used by markup without font attributes
+    warm(nullptr);
+    for (const auto &font : fonts) {
+        auto desc = pango_font_description_from_string(font.c_str());
+        warm(desc);
+        pango_font_description_free(desc);
+    }
+    g_object_unref(layout);
+    g_object_unref(context);
+    cairo_destroy(cr);
+    cairo_surface_destroy(surface);
+}
+
+void FontWarmup::Finish() {
+    if (!m_thread.joinable()) {
+        return;
+    }
+    auto start = std::chrono::steady_clock::now();
+    m_thread.join();
+    auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - start);
+    spdlog::debug("Waited {}us for font warmup", elapsed.count());
+    // Pango font maps are per thread, layouts created by this thread from now on find the
+    // fonts already loaded.
+    pango_cairo_font_map_set_default(PANGO_CAIRO_FONT_MAP(m_fontMap));
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "pango/pango-layout.h"
+
+// Loads fontconfig and shapes text in the configured fonts on a background thread while the
+// Wayland and Sway connections are set up. Without it the first show of the panels pays for
+// loading the font caches.
+class FontWarmup {
+   public:
+    // Fonts are Pango font descriptions like "digital-7 40", the default font is always warmed
+    static std::unique_ptr<FontWarmup> Start(std::vector<std::string> fonts);
+    virtual ~FontWarmup();
+
+    // Waits for the warmup and makes the warmed font map the default of the calling thread,
+    // should be called before the calling thread lays out any text.
+    void Finish();
+    // Loads and shapes the fonts in the default font map of the calling thread, for threads
+    // other than the one calling Finish that lay out text.
+    static void WarmThread(const std::vector<std::string> &fonts);
+
+   private:
+    FontWarmup() : m_fontMap(nullptr) {}
+    void Run(const std::vector<std::string> &fonts);
+    static void Warm(PangoFontMap *fontMap, const std::vector<std::string> &fonts);
+
+    std::thread m_thread;
+    // Only touched by the warmup thread until it is joined
+    PangoFontMap *m_fontMap;
+};
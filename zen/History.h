@@ -0,0 +1,38 @@
+#pragma once
+
+#include <cstddef>
+#include <deque>
+#include <vector>
+
+// Samples of a value taken on a fixed schedule, the most recent samples are kept. The value is
+// set whenever it changes and sampled by a timer, so every sample covers the same amount of time
+// however often the value changes.
+class History {
+   public:
+    explicit History(size_t capacity) : m_capacity(capacity), m_hasValue(false), m_value(0) {}
+
+    // Current value, taken by the next sample
+    void Set(float value) {
+        m_value = value;
+        m_hasValue = true;
+    }
+    // Takes the current value as the most recent sample, nothing until a value has been set
+    void Sample() {
+        if (!m_hasValue || m_capacity == 0) return;
+        if (m_samples.size() == m_capacity) {
+            m_samples.pop_front();
+        }
+        m_samples.push_back(m_value);
+    }
+    // Appends the samples to values, oldest first
+    void Values(std::vector<float>& values) const {
+        values.insert(values.end(), m_samples.begin(), m_samples.end());
+    }
+    size_t NumSamples() const { return m_samples.size(); }
+
+   private:
+    const size_t m_capacity;
+    bool m_hasValue;
+    float m_value;
+    std::deque<float> m_samples;
+};
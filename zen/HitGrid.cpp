@@ -0,0 +1,76 @@
+#include "zen/HitGrid.h"
+
+#include <algorithm>
+
+void HitGrid::ForEachCell(const Rect& rect, auto&& f) const {
+    // Contains includes the right and bottom edge
+    const int left = std::clamp(rect.x / cellSize, 0, m_columns - 1);
+    const int right = std::clamp((rect.x + rect.cx) / cellSize, 0, m_columns - 1);
+    const int top = std::clamp(rect.y / cellSize, 0, m_rows - 1);
+    const int bottom = std::clamp((rect.y + rect.cy) / cellSize, 0, m_rows - 1);
+    for (int row = top; row <= bottom; row++) {
+        for (int column = left; column <= right; column++) {
+            f(row * m_columns + column);
+        }
+    }
+}
+
+void HitGrid::Build(const DrawnPanel& drawn) {
+    m_columns = std::max(drawn.size.cx / cellSize + 1, 1);
+    m_rows = std::max(drawn.size.cy / cellSize + 1, 1);
+    const size_t numCells = m_columns * m_rows;
+    // Count entries per cell, then place them
+    m_offsets.assign(numCells + 1, 0);
+    auto forEachEntry = [&drawn](auto&& f) {
+        for (size_t i = 0; i < drawn.widgets.size(); i++) {
+            const auto& widget = drawn.widgets[i];
+            f(Entry{.position = widget.position, .widget = (uint32_t)i, .target = -1});
+            for (size_t t = 0; t < widget.targets.size(); t++) {
+                f(Entry{.position = widget.targets[t].position,
+                        .widget = (uint32_t)i,
+                        .target = (int32_t)t});
+            }
+        }
+    };
+    forEachEntry([this](const Entry& entry) {
+        ForEachCell(entry.position, [this](int cell) { m_offsets[cell + 1]++; });
+    });
+    for (size_t i = 0; i < numCells; i++) {
+        m_offsets[i + 1] += m_offsets[i];
+    }
+    m_entries.resize(m_offsets[numCells]);
+    thread_local std::vector<uint32_t> next;
+    next.assign(m_offsets.begin(), m_offsets.end() - 1);
+    forEachEntry([this](const Entry& entry) {
+        ForEachCell(entry.position, [this, &entry](int cell) { m_entries[next[cell]++] = entry; });
+    });
+}
+
+bool HitGrid::Find(int x, int y, size_t& widget, int& target) const {
+    if (m_columns == 0 || x < 0 || y < 0) {
+        return false;
+    }
+    const int column = x / cellSize;
+    const int row = y / cellSize;
+    if (column >= m_columns || row >= m_rows) {
+        return false;
+    }
+    const int cell = row * m_columns + column;
+    bool isFound = false;
+    target = -1;
+    for (uint32_t i = m_offsets[cell]; i < m_offsets[cell + 1]; i++) {
+        const auto& entry = m_entries[i];
+        if (!entry.position.Contains(x, y)) continue;
+        if (!isFound && entry.target == -1) {
+            // First widget at the point
+            widget = entry.widget;
+            isFound = true;
+        } else if (isFound && entry.widget == widget && entry.target != -1) {
+            target = entry.target;
+            return true;
+        } else if (isFound && entry.widget != widget) {
+            break;
+        }
+    }
+    return isFound;
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "zen/Draw.h"
+
+// Uniform grid over the widgets and targets of a drawn panel. Finds what is at a point by only
+// testing the widgets and targets that overlaps the cell of the point.
+class HitGrid {
+   public:
+    HitGrid() : m_columns(0), m_rows(0) {}
+
+    void Build(const DrawnPanel& drawn);
+    // Returns false when there is no widget at x, y. The target is the first target of the
+    // widget at x, y or -1 when there is none, same order as when testing them one by one.
+    bool Find(int x, int y, size_t& widget, int& target) const;
+
+   private:
+    static constexpr int cellSize = 32;
+    struct Entry {
+        Rect position;
+        uint32_t widget;
+        // -1 for the widget itself
+        int32_t target;
+    };
+    void ForEachCell(const Rect& rect, auto&& f) const;
+
+    int m_columns;
+    int m_rows;
+    // Entries of cell i are in m_entries[m_offsets[i]] to m_entries[m_offsets[i + 1]], in the
+    // order of the drawn panel.
+    std::vector<uint32_t> m_offsets;
+    std::vector<Entry> m_entries;
+};
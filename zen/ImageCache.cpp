@@ -0,0 +1,146 @@
+#include "zen/ImageCache.h"
+
+#include <librsvg/rsvg.h>
+#include <spdlog/spdlog.h>
+
+#include <cmath>
+#include <functional>
+
+std::unique_ptr<ImageCache> ImageCache::Create(size_t capacity) {
+    return std::unique_ptr<ImageCache>(new ImageCache(capacity));
+}
+
+ImageCache& ImageCache::ForThread() {
+    thread_local auto cache = ImageCache::Create(64);
+    return *cache;
+}
+
+ImageCache::~ImageCache() {
+    for (auto& entry : m_entries) {
+        if (entry.second.surface) cairo_surface_destroy(entry.second.surface);
+    }
+}
+
+size_t ImageCache::KeyHash::operator()(const Key& key) const {
+    auto hash = std::hash<std::string>{}(key.path);
+    HashCombine(hash, key.cx);
+    HashCombine(hash, key.cy);
+    HashCombine(hash, std::hash<double>{}(key.scale));
+    return hash;
+}
+
+Size ImageCache::ResolveSize(const Size& size, double cx, double cy) {
+    if (size.cx > 0 && size.cy > 0) return size;
+    if (size.cx > 0) return Size{size.cx, (int)std::lround(size.cx * cy / cx)};
+    if (size.cy > 0) return Size{(int)std::lround(size.cy * cx / cy), size.cy};
+    return Size{(int)std::lround(cx), (int)std::lround(cy)};
+}
+
+static cairo_surface_t* CreateSurface(const Size& size, double scale, cairo_t*& cr) {
+    auto surface = cairo_image_surface_create(CAIRO_FORMAT_ARGB32, std::lround(size.cx * scale),
+                                              std::lround(size.cy * scale));
+    cr = cairo_create(surface);
+    return surface;
+}
+
+static cairo_surface_t* LoadSvg(const std::string& path, const Size& requested, double scale,
+                                Size& size) {
+    GError* error = nullptr;
+    auto handle = rsvg_handle_new_from_file(path.c_str(), &error);
+    if (!handle) {
+        spdlog::error("Failed to load image {}: {}", path, error ? error->message : "");
+        if (error) g_error_free(error);
+        return nullptr;
+    }
+    double cx = 0, cy = 0;
+    if (!rsvg_handle_get_intrinsic_size_in_pixels(handle, &cx, &cy) || cx <= 0 || cy <= 0) {
+        // Only a view box, use it as is when both dimensions are specified
+        cx = requested.cx;
+        cy = requested.cy;
+    }
+    if (cx <= 0 || cy <= 0) {
+        spdlog::error("Image {} has no size, specify width and height", path);
+        g_object_unref(handle);
+        return nullptr;
+    }
+    size = ImageCache::ResolveSize(requested, cx, cy);
+    cairo_t* cr;
+    auto surface = CreateSurface(size, scale, cr);
+    RsvgRectangle viewport{.x = 0, .y = 0, .width = size.cx * scale, .height = size.cy * scale};
+    if (!rsvg_handle_render_document(handle, cr, &viewport, &error)) {
+        spdlog::error("Failed to render image {}: {}", path, error ? error->message : "");
+        if (error) g_error_free(error);
+        cairo_surface_destroy(surface);
+        surface = nullptr;
+    }
+    cairo_destroy(cr);
+    g_object_unref(handle);
+    return surface;
+}
+
+static cairo_surface_t* LoadPng(const std::string& path, const Size& requested, double scale,
+                                Size& size) {
+    auto png = cairo_image_surface_create_from_png(path.c_str());
+    if (cairo_surface_status(png) != CAIRO_STATUS_SUCCESS) {
+        spdlog::error("Failed to load image {}", path);
+        cairo_surface_destroy(png);
+        return nullptr;
+    }
+    const auto cx = cairo_image_surface_get_width(png);
+    const auto cy = cairo_image_surface_get_height(png);
+    size = ImageCache::ResolveSize(requested, cx, cy);
+    cairo_t* cr;
+    auto surface = CreateSurface(size, scale, cr);
+    cairo_scale(cr, size.cx * scale / cx, size.cy * scale / cy);
+    cairo_set_source_surface(cr, png, 0, 0);
+    cairo_pattern_set_filter(cairo_get_source(cr), CAIRO_FILTER_GOOD);
+    cairo_set_operator(cr, CAIRO_OPERATOR_SOURCE);
+    cairo_paint(cr);
+    cairo_destroy(cr);
+    cairo_surface_destroy(png);
+    return surface;
+}
+
+cairo_surface_t* ImageCache::Get(cairo_t* cr, std::string_view path, const Size& size,
+                                 Size& drawnSize) {
+    double scaleX, scaleY;
+    cairo_surface_get_device_scale(cairo_get_target(cr), &scaleX, &scaleY);
+    m_lookup.path.assign(path);
+    m_lookup.cx = size.cx;
+    m_lookup.cy = size.cy;
+    m_lookup.scale = scaleX;
+
+    auto it = m_map.find(m_lookup);
+    if (it != m_map.end()) {
+        m_stats.hits++;
+        // Move to front
+        m_entries.splice(m_entries.begin(), m_entries, it->second);
+        const auto& image = it->second->second;
+        drawnSize = image.size;
+        return image.surface ? cairo_surface_reference(image.surface) : nullptr;
+    }
+    m_stats.misses++;
+    Image image{.surface = nullptr, .size = {}};
+    if (path.ends_with(".svg") || path.ends_with(".svgz")) {
+        image.surface = LoadSvg(m_lookup.path, size, scaleX, image.size);
+    } else {
+        image.surface = LoadPng(m_lookup.path, size, scaleX, image.size);
+    }
+    if (image.surface) {
+        // Drawn 1:1 in device pixels
+        cairo_surface_set_device_scale(image.surface, scaleX, scaleX);
+    }
+    if (m_entries.size() >= m_capacity) {
+        auto& last = m_entries.back();
+        m_map.erase(last.first);
+        if (last.second.surface) cairo_surface_destroy(last.second.surface);
+        m_entries.pop_back();
+        m_stats.evictions++;
+    }
+    m_entries.emplace_front(m_lookup, image);
+    m_map[m_entries.front().first] = m_entries.begin();
+    spdlog::trace("Image cache miss, hits {}, misses {}, evictions {}", m_stats.hits,
+                  m_stats.misses, m_stats.evictions);
+    drawnSize = image.size;
+    return image.surface ? cairo_surface_reference(image.surface) : nullptr;
+}
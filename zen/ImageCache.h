@@ -0,0 +1,65 @@
+#pragma once
+
+#include <list>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+#include "cairo.h"
+#include "zen/RenderTree.h"
+
+// Least recently used cache of decoded images, scaled to the size they are drawn in. Decoding
+// and scaling is done once, drawing a cached image is a single blit.
+class ImageCache {
+   public:
+    struct Stats {
+        int hits;
+        int misses;
+        int evictions;
+    };
+
+    static std::unique_ptr<ImageCache> Create(size_t capacity);
+    // Shared by everything drawn by the calling thread, same as the layout cache.
+    static ImageCache& ForThread();
+    virtual ~ImageCache();
+
+    // Returns a new reference to a premultiplied image surface of the PNG or SVG file at path
+    // scaled to size in surface units, or null if the file could not be loaded. A size of 0 in
+    // one dimension keeps the aspect ratio of the image, 0 in both uses the size of the image.
+    // The device scale of the returned surface is set to match cr, the size it should be drawn
+    // in is returned in drawnSize. The surface should be released with cairo_surface_destroy.
+    cairo_surface_t* Get(cairo_t* cr, std::string_view path, const Size& size, Size& drawnSize);
+    const Stats& GetStats() const { return m_stats; }
+    // Fills in dimensions of size that are 0 from an image of cx by cy, keeping its aspect ratio
+    static Size ResolveSize(const Size& size, double cx, double cy);
+
+   private:
+    struct Key {
+        std::string path;
+        int cx;
+        int cy;
+        double scale;
+        bool operator==(const Key&) const = default;
+    };
+    struct KeyHash {
+        size_t operator()(const Key& key) const;
+    };
+    struct Image {
+        // Null when the file could not be loaded, to avoid reading it again on every frame
+        cairo_surface_t* surface;
+        Size size;
+    };
+    using Entry = std::pair<Key, Image>;
+    using Entries = std::list<Entry>;
+
+    ImageCache(size_t capacity) : m_capacity(capacity), m_stats{}, m_lookup{} {}
+
+    const size_t m_capacity;
+    Stats m_stats;
+    // Most recently used first
+    Entries m_entries;
+    std::unordered_map<Key, Entries::iterator, KeyHash> m_map;
+    // Reused for lookups to avoid allocating a key on every hit
+    Key m_lookup;
+};
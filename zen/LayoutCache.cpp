@@ -0,0 +1,63 @@
+#include "zen/LayoutCache.h"
+
+#include <spdlog/spdlog.h>
+
+#include <functional>
+
+#include "pango/pangocairo.h"
+
+std::unique_ptr<LayoutCache> LayoutCache::Create(size_t capacity) {
+    return std::unique_ptr<LayoutCache>(new LayoutCache(capacity));
+}
+
+LayoutCache& LayoutCache::ForThread() {
+    thread_local auto cache = LayoutCache::Create(256);
+    return *cache;
+}
+
+LayoutCache::~LayoutCache() {
+    for (auto& entry : m_entries) {
+        g_object_unref(entry.second);
+    }
+}
+
+size_t LayoutCache::KeyHash::operator()(const Key& key) const {
+    auto hash = std::hash<std::string>{}(key.markup);
+    hash ^= std::hash<unsigned long>{}(key.fontOptions) + 0x9e3779b9 + (hash << 6) + (hash >> 2);
+    hash ^= std::hash<double>{}(key.scale) + 0x9e3779b9 + (hash << 6) + (hash >> 2);
+    return hash;
+}
+
+PangoLayout* LayoutCache::Get(cairo_t* cr, std::string_view markup) {
+    auto options = cairo_font_options_create();
+    cairo_get_font_options(cr, options);
+    double scaleX, scaleY;
+    cairo_surface_get_device_scale(cairo_get_target(cr), &scaleX, &scaleY);
+    m_lookup.markup.assign(markup);
+    m_lookup.fontOptions = cairo_font_options_hash(options);
+    m_lookup.scale = scaleX;
+    cairo_font_options_destroy(options);
+
+    auto it = m_map.find(m_lookup);
+    if (it != m_map.end()) {
+        m_stats.hits++;
+        // Move to front
+        m_entries.splice(m_entries.begin(), m_entries, it->second);
+        return (PangoLayout*)g_object_ref(it->second->second);
+    }
+    m_stats.misses++;
+    auto layout = pango_cairo_create_layout(cr);
+    pango_layout_set_markup(layout, m_lookup.markup.c_str(), -1);
+    if (m_entries.size() >= m_capacity) {
+        auto& last = m_entries.back();
+        m_map.erase(last.first);
+        g_object_unref(last.second);
+        m_entries.pop_back();
+        m_stats.evictions++;
+    }
+    m_entries.emplace_front(m_lookup, layout);
+    m_map[m_entries.front().first] = m_entries.begin();
+    spdlog::trace("Layout cache miss, hits {}, misses {}, evictions {}", m_stats.hits,
+                  m_stats.misses, m_stats.evictions);
+    return (PangoLayout*)g_object_ref(layout);
+}
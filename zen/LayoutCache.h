@@ -0,0 +1,56 @@
+#pragma once
+
+#include <list>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+#include "cairo.h"
+#include "pango/pango-layout.h"
+
+// Least recently used cache of laid out markup. Parsing markup and shaping text is the most
+// expensive part of a frame and the same strings are drawn over and over again.
+class LayoutCache {
+   public:
+    struct Stats {
+        int hits;
+        int misses;
+        int evictions;
+    };
+
+    static std::unique_ptr<LayoutCache> Create(size_t capacity);
+    // Shared by all panels and outputs drawn by the calling thread. Pango contexts and layouts
+    // must not be used by multiple threads, so every rasterizing thread has a cache of its own
+    // and lays out markup it has not seen before even when another thread already has.
+    static LayoutCache& ForThread();
+    virtual ~LayoutCache();
+
+    // Returns a new reference to a layout of markup that is compatible with cr, the returned
+    // layout should be released with g_object_unref and must not be modified.
+    PangoLayout* Get(cairo_t* cr, std::string_view markup);
+    const Stats& GetStats() const { return m_stats; }
+
+   private:
+    struct Key {
+        std::string markup;
+        unsigned long fontOptions;
+        double scale;
+        bool operator==(const Key&) const = default;
+    };
+    struct KeyHash {
+        size_t operator()(const Key& key) const;
+    };
+    using Entry = std::pair<Key, PangoLayout*>;
+    using Entries = std::list<Entry>;
+
+    LayoutCache(size_t capacity) : m_capacity(capacity), m_stats{}, m_lookup{} {}
+
+    const size_t m_capacity;
+    Stats m_stats;
+    // Most recently used first
+    Entries m_entries;
+    std::unordered_map<Key, Entries::iterator, KeyHash> m_map;
+    // Reused for lookups to avoid allocating a key on every hit
+    Key m_lookup;
+};
@@ -1,74 +1,154 @@
 #include "zen/MainLoop.h"
 
 #include <spdlog/spdlog.h>
+#include <sys/epoll.h>
 #include <sys/eventfd.h>
+#include <unistd.h>
+
+#include <cstring>
+
+#include "zen/Timers.h"
 
 std::unique_ptr<MainLoop> MainLoop::Create() {
+    int epollFd = epoll_create1(EPOLL_CLOEXEC);
+    if (epollFd == -1) {
+        spdlog::error("Failed to create epoll instance: {}", strerror(errno));
+        return nullptr;
+    }
     // Open event channel
-    int eventFd = eventfd(0, EFD_NONBLOCK);
+    int eventFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
     if (eventFd == -1) {
+        close(epollFd);
+        return nullptr;
+    }
+    // Internal events are identified by not having a registration
+    epoll_event event = {.events = EPOLLIN, .data = {.ptr = nullptr}};
+    if (epoll_ctl(epollFd, EPOLL_CTL_ADD, eventFd, &event) == -1) {
+        spdlog::error("Failed to add event channel to epoll: {}", strerror(errno));
+        close(eventFd);
+        close(epollFd);
+        return nullptr;
+    }
+    auto timers = Timers::Create();
+    if (!timers) {
+        close(eventFd);
+        close(epollFd);
         return nullptr;
     }
-    return std::unique_ptr<MainLoop>(new MainLoop(eventFd));
+    auto mainLoop = std::unique_ptr<MainLoop>(new MainLoop(epollFd, eventFd, timers));
+    if (!mainLoop->RegisterIoHandler(timers->Fd(), "Timers", timers)) {
+        return nullptr;
+    }
+    return mainLoop;
+}
+
+MainLoop::~MainLoop() {
+    close(m_wakeupFd);
+    close(m_epollFd);
 }
 
 void MainLoop::Run() {
-    // Register internal events
-    m_polls.push_back(pollfd{.fd = m_wakeupFd, .events = POLLIN, .revents = 0});
+    while (Dispatch()) {
+    }
+}
 
-    do {
-        // Should be ppoll
-        int num = poll(m_polls.data(), m_polls.size(), -1);
-        if (num < 0) {
-            // Error!
-            spdlog::error("Poll error in main loop");
-            break;
+bool MainLoop::Dispatch() {
+    constexpr int maxEvents = 16;
+    epoll_event events[maxEvents];
+    int num = epoll_wait(m_epollFd, events, maxEvents, -1);
+    if (num < 0) {
+        if (errno == EINTR) {
+            return true;
         }
-        if (num == 0) {
-            // Timeout
-            spdlog::error("Timeout in main loop");
+        // Error!
+        spdlog::error("Epoll error in main loop: {}", strerror(errno));
+        return false;
+    }
+    if (num == 0) {
+        // Timeout
+        spdlog::error("Timeout in main loop");
+        return true;
+    }
+    // Process
+    spdlog::trace("{} events in main loop", num);
+    bool anyDirty = false;
+    for (int i = 0; i < num; i++) {
+        auto registration = (Registration*)events[i].data.ptr;
+        // Special treatment on internal events. Empty events and
+        // rely on batch processing when all other events has been processed
+        if (!registration) {
+            uint64_t ignore;
+            spdlog::trace("Popping internal event");
+            m_wakupMutex.lock();
+            read(m_wakeupFd, &ignore, sizeof(uint64_t));
+            m_wakupMutex.unlock();
+            // For now internal events always means that a source is dirty
+            anyDirty = true;
             continue;
         }
-        // Process
-        spdlog::trace("{} events in main loop", num);
-        bool anyDirty = false;
-        for (auto& poll : m_polls) {
-            if ((poll.events & poll.revents) != 0) {
-                // Special treatment on internal events. Empty events and
-                // rely on batch processing when all other events has been processed
-                if (poll.fd == m_wakeupFd) {
-                    uint64_t ignore;
-                    spdlog::trace("Popping internal event");
-                    m_wakupMutex.lock();
-                    read(m_wakeupFd, &ignore, sizeof(uint64_t));
-                    m_wakupMutex.unlock();
-                    // For now internal events always means that a source is dirty
-                    anyDirty = true;
-                } else {
-                    auto& handler = m_handlers[poll.fd];
-                    spdlog::trace("Invoking io handler for fd {}", poll.fd);
-                    anyDirty = handler->OnRead() || anyDirty;
-                    spdlog::trace("Io handler done");
-                }
-            }
-        }
-        if (anyDirty && m_handler) {
-            m_handler->OnChanged();
-        }
-        if (m_alerted) {
-            m_handler->OnAlerted();
-            m_alerted = false;
+        // Might have been unregistered by a previous handler in this batch
+        if (!registration->isRegistered) {
+            continue;
         }
-    } while (m_polls.size() > 0);
+        spdlog::trace("Invoking io handler {} for fd {}", registration->name, registration->fd);
+        anyDirty = registration->handler->OnRead() || anyDirty;
+        spdlog::trace("Io handler done");
+    }
+    // No more references to unregistered handlers from this batch
+    m_unregistered.clear();
+    if (anyDirty && m_handler) {
+        m_handler->OnChanged();
+    }
+    if (m_alerted) {
+        m_handler->OnAlerted();
+        m_alerted = false;
+    }
+    return true;
 }
 
-void MainLoop::RegisterIoHandler(int fd, const std::string_view name,
+bool MainLoop::RegisterIoHandler(int fd, const std::string_view name,
                                  std::shared_ptr<IoHandler> ioHandler) {
-    m_handlers[fd] = ioHandler;
-    m_polls.push_back(pollfd{.fd = fd, .events = POLLIN, .revents = 0});
+    if (m_registrations.contains(fd)) {
+        spdlog::error("Fd {} is already registered in main loop, can not register {}", fd, name);
+        return false;
+    }
+    auto registration = std::unique_ptr<Registration>(new Registration{
+        .fd = fd, .name = std::string(name), .handler = ioHandler, .isRegistered = true});
+    epoll_event event = {.events = EPOLLIN, .data = {.ptr = registration.get()}};
+    if (epoll_ctl(m_epollFd, EPOLL_CTL_ADD, fd, &event) == -1) {
+        spdlog::error("Failed to register {} in main loop: {}", name, strerror(errno));
+        return false;
+    }
+    m_registrations[fd] = std::move(registration);
     spdlog::debug("Registering {} in main loop for fd {}", name, fd);
+    return true;
+}
+
+void MainLoop::UnregisterIoHandler(int fd) {
+    auto it = m_registrations.find(fd);
+    if (it == m_registrations.end()) {
+        spdlog::warn("Fd {} is not registered in main loop", fd);
+        return;
+    }
+    auto registration = std::move(it->second);
+    m_registrations.erase(it);
+    spdlog::debug("Unregistering {} from main loop for fd {}", registration->name, fd);
+    // Fd might already have been closed which implicitly removes it from epoll
+    epoll_ctl(m_epollFd, EPOLL_CTL_DEL, fd, nullptr);
+    // Events for this fd might already be fetched in current batch, keep the registration
+    // until the batch is done.
+    registration->isRegistered = false;
+    m_unregistered.push_back(std::move(registration));
 }
 
+int MainLoop::RegisterTimer(const std::string_view name, std::chrono::milliseconds initial,
+                            std::chrono::milliseconds period, std::chrono::milliseconds slack,
+                            std::shared_ptr<TimerHandler> timerHandler) {
+    return m_timers->Add(name, initial, period, slack, timerHandler);
+}
+
+void MainLoop::UnregisterTimer(int id) { m_timers->Remove(id); }
+
 void MainLoop::RegisterNotificationHandler(std::shared_ptr<NotificationHandler> batchHandler) {
     if (m_handler) {
         spdlog::error("Only one batch handler supported");
@@ -1,11 +1,11 @@
 #pragma once
 
-#include <poll.h>
-
 #include <atomic>
+#include <chrono>
 #include <map>
 #include <memory>
 #include <mutex>
+#include <string>
 #include <vector>
 
 class IoHandler {
@@ -15,6 +15,13 @@ class IoHandler {
     virtual bool OnRead() = 0;
 };
 
+class TimerHandler {
+   public:
+    virtual ~TimerHandler() {}
+    // Return true if timeout causes handler to be dirty
+    virtual bool OnTimeout() = 0;
+};
+
 class NotificationHandler {
    public:
     virtual ~NotificationHandler() {}
@@ -22,13 +29,26 @@ class NotificationHandler {
     virtual void OnAlerted() = 0;
 };
 
+class Timers;
+
 class MainLoop {
    public:
     static std::unique_ptr<MainLoop> Create();
+    ~MainLoop();
 
     void Run();
-    void RegisterIoHandler(int fd, const std::string_view name,
+    // Waits for and handles one batch of events, returns false when waiting failed
+    bool Dispatch();
+    bool RegisterIoHandler(int fd, const std::string_view name,
                            std::shared_ptr<IoHandler> ioHandler);
+    // Safe to call from within an io handler, also for the handler that is currently invoked.
+    void UnregisterIoHandler(int fd);
+    // Periodic timer, first timeout after initial and then every period. The timeout might be
+    // delayed up to slack to coalesce it with other timers. Returns id of the timer.
+    int RegisterTimer(const std::string_view name, std::chrono::milliseconds initial,
+                      std::chrono::milliseconds period, std::chrono::milliseconds slack,
+                      std::shared_ptr<TimerHandler> timerHandler);
+    void UnregisterTimer(int id);
     void RegisterNotificationHandler(std::shared_ptr<NotificationHandler> ioBatchHandler);
     // In cases where polling for events is done on another thread that thread should
     // call this to trigger dirty check on all registered io handlers.
@@ -38,12 +58,24 @@ class MainLoop {
     void AlertAndWakeup();
 
    private:
-    MainLoop(int eventFd) : m_wakeupFd(eventFd) {}
+    // Pointer to registration is stored in epoll event data, registration is kept
+    // alive until end of current batch when unregistered.
+    struct Registration {
+        int fd;
+        std::string name;
+        std::shared_ptr<IoHandler> handler;
+        bool isRegistered;
+    };
+
+    MainLoop(int epollFd, int eventFd, std::shared_ptr<Timers> timers)
+        : m_epollFd(epollFd), m_wakeupFd(eventFd), m_timers(timers) {}
 
+    int m_epollFd;
     int m_wakeupFd;
     std::mutex m_wakupMutex;
     std::atomic<bool> m_alerted;
-    std::vector<pollfd> m_polls;
-    std::map<int, std::shared_ptr<IoHandler>> m_handlers;
+    std::map<int, std::unique_ptr<Registration>> m_registrations;
+    std::vector<std::unique_ptr<Registration>> m_unregistered;
+    std::shared_ptr<Timers> m_timers;
     std::shared_ptr<NotificationHandler> m_handler;
 };
@@ -1,10 +1,16 @@
 #include "zen/Manager.h"
 
+#include <algorithm>
+#include <chrono>
+
 #include "spdlog/spdlog.h"
 #include "zen/Registry.h"
 
-std::shared_ptr<Manager> Manager::Create(std::shared_ptr<Registry> registry) {
-    auto manager = std::shared_ptr<Manager>(new Manager(registry));
+using namespace std::chrono_literals;
+
+std::shared_ptr<Manager> Manager::Create(std::shared_ptr<Registry> registry, MainLoop& mainLoop,
+                                         bool prerender) {
+    auto manager = std::shared_ptr<Manager>(new Manager(registry, mainLoop, prerender));
     // Register click handler
     if (!registry->seat) {
         spdlog::error("No seat in registry");
@@ -14,10 +20,29 @@ std::shared_ptr<Manager> Manager::Create(std::shared_ptr<Registry> registry) {
         [manager](auto surface, int x, int y) { manager->ClickSurface(surface, x, y); },
         [manager](auto surface, int x, int y, int value) {
             manager->WheelSurface(surface, x, y, value);
-        });
+        },
+        [manager](auto surface, int x, int y) { manager->HoverSurface(surface, x, y); });
     return manager;
 }
 
+void Manager::SchedulePrerender() {
+    if (!m_prerender || m_needsPrerender) {
+        return;
+    }
+    m_needsPrerender = true;
+    // Low priority, let the timeout be delayed to coalesce with other wakeups. Removed when it
+    // fires, the period is never used.
+    m_prerenderTimer = m_mainLoop.RegisterTimer("Prerender", 1s, 1s, 3s, shared_from_this());
+}
+
+void Manager::CancelPrerender() {
+    m_needsPrerender = false;
+    if (m_prerenderTimer) {
+        m_mainLoop.UnregisterTimer(m_prerenderTimer);
+        m_prerenderTimer = 0;
+    }
+}
+
 void Manager::ClickSurface(wl_surface* surface, int x, int y) {
     spdlog::debug("Click in surface {} at {},{}", (void*)surface, x, y);
     m_registry->BorrowOutputs().ClickSurface(surface, x, y);
@@ -28,12 +53,21 @@ void Manager::WheelSurface(wl_surface* surface, int x, int y, int value) {
     m_registry->BorrowOutputs().WheelSurface(surface, x, y, value);
 }
 
+void Manager::HoverSurface(wl_surface* surface, int x, int y) {
+    spdlog::trace("Hover in surface {} at {},{}", (void*)surface, x, y);
+    // Redrawn as a deferred draw when hover changed the look of a panel
+    m_registry->BorrowOutputs().HoverSurface(surface, x, y);
+}
+
 void Manager::OnChanged() {
     m_sources->PublishAll();
     if (m_visibilityChanged) {
         m_visibilityChanged = false;
         if (m_isVisible) {
-            m_sources->ForceRedraw();
+            // Prerendered panels are already up to date except for changes since last prerender
+            if (!m_prerender) {
+                m_sources->ForceRedraw();
+            }
             if (m_alerted) {
                 m_registry->BorrowOutputs().HideAlert(*m_registry);
                 m_alerted = false;
@@ -45,9 +79,52 @@ void Manager::OnChanged() {
     if (m_isVisible) {
         m_registry->BorrowOutputs().Draw(*m_registry, *m_sources);
         m_sources->SetAllDrawn();
-    } else if (m_alerted) {
-        m_registry->BorrowOutputs().DrawAlert(*m_registry);
+        // Deferred panels are committed in later batches, when the compositor is ready
+        if (m_shownAt && !m_registry->BorrowOutputs().HasPendingDraws()) {
+            auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(
+                std::chrono::steady_clock::now() - *m_shownAt);
+            spdlog::debug("Show latency {}us from visibility event to commit, prerendered: {}",
+                          elapsed.count(), m_prerender);
+            m_shownAt.reset();
+            AddShowLatency(elapsed);
+        }
+    } else {
+        // Prerendered on next timeout
+        SchedulePrerender();
+        if (m_alerted) {
+            m_registry->BorrowOutputs().DrawAlert(*m_registry);
+        }
+    }
+}
+
+bool Manager::OnTimeout() {
+    const bool needsPrerender = m_needsPrerender;
+    CancelPrerender();
+    if (m_isVisible || !needsPrerender || !m_sources) {
+        return false;
+    }
+    auto start = std::chrono::steady_clock::now();
+    m_registry->BorrowOutputs().Prerender(*m_registry, *m_sources);
+    m_sources->SetAllDrawn();
+    auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - start);
+    spdlog::debug("Prerendered in {}us", elapsed.count());
+    return false;
+}
+
+void Manager::AddShowLatency(std::chrono::microseconds latency) {
+    // Enough shows to compare runs with and without prerender
+    constexpr size_t numLatencies = 20;
+    m_showLatencies.push_back(latency.count());
+    if (m_showLatencies.size() < numLatencies) {
+        return;
     }
+    std::sort(m_showLatencies.begin(), m_showLatencies.end());
+    spdlog::info("Show latency of last {} shows, median {}us, 90th percentile {}us, max {}us, "
+                 "prerender: {}",
+                 numLatencies, m_showLatencies[numLatencies / 2],
+                 m_showLatencies[numLatencies * 9 / 10], m_showLatencies.back(), m_prerender);
+    m_showLatencies.clear();
 }
 
 void Manager::OnAlerted() {
@@ -56,12 +133,18 @@ void Manager::OnAlerted() {
 }
 
 void Manager::Hide() {
+    m_shownAt.reset();
     m_isVisible = false;
     m_visibilityChanged = true;
     OnChanged();
 }
 
 void Manager::Show() {
+    // Invoked while the compositor event is read, latency is measured from here until the last
+    // panel has been committed.
+    m_shownAt = std::chrono::steady_clock::now();
+    // Changes are drawn now instead
+    CancelPrerender();
     m_isVisible = true;
     m_visibilityChanged = true;
     OnChanged();
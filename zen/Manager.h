@@ -1,13 +1,22 @@
 #pragma once
 
+#include <chrono>
+#include <memory>
+#include <optional>
+#include <vector>
+
 #include "zen/MainLoop.h"
 #include "zen/Output.h"
 #include "zen/ScriptContext.h"
 #include "zen/Sources/Sources.h"
 
-class Manager : public NotificationHandler {
+class Manager : public NotificationHandler,
+                public TimerHandler,
+                public std::enable_shared_from_this<Manager> {
    public:
-    static std::shared_ptr<Manager> Create(std::shared_ptr<Registry> registry);
+    // When prerender is enabled panels are rendered in the background while hidden
+    static std::shared_ptr<Manager> Create(std::shared_ptr<Registry> registry,
+                                           MainLoop& mainLoop, bool prerender);
     void SetSources(std::unique_ptr<Sources> sources) { m_sources = std::move(sources); }
     virtual ~Manager() {}
     // When a batch of IO events has been processed and sources needs to be published and/or needs
@@ -15,6 +24,8 @@ class Manager : public NotificationHandler {
     void OnChanged() override;
 
     void OnAlerted() override;
+    // Prerenders changes while hidden, a single timeout after changes
+    bool OnTimeout() override;
 
     // Compositors tells manager when the overlays should be visible
     void Show();
@@ -22,14 +33,34 @@ class Manager : public NotificationHandler {
 
     void ClickSurface(wl_surface* surface, int x, int y);
     void WheelSurface(wl_surface* surface, int x, int y, int value);
+    void HoverSurface(wl_surface* surface, int x, int y);
 
    private:
-    Manager(std::shared_ptr<Registry> registry)
-        : m_registry(registry), m_isVisible(false), m_visibilityChanged(false), m_alerted(false) {}
+    Manager(std::shared_ptr<Registry> registry, MainLoop& mainLoop, bool prerender)
+        : m_registry(registry),
+          m_mainLoop(mainLoop),
+          m_isVisible(false),
+          m_visibilityChanged(false),
+          m_alerted(false),
+          m_prerender(prerender),
+          m_needsPrerender(false),
+          m_prerenderTimer(0) {}
+    void AddShowLatency(std::chrono::microseconds latency);
+    void SchedulePrerender();
+    void CancelPrerender();
 
     std::shared_ptr<Registry> m_registry;
+    MainLoop& m_mainLoop;
     bool m_isVisible;
     bool m_visibilityChanged;
     std::unique_ptr<Sources> m_sources;
     bool m_alerted;
+    const bool m_prerender;
+    bool m_needsPrerender;
+    // Armed while a prerender is needed, 0 when not armed
+    int m_prerenderTimer;
+    // When the overlay was requested to be shown, until all panels are committed
+    std::optional<std::chrono::steady_clock::time_point> m_shownAt;
+    // Latencies in microseconds of shows since last summary
+    std::vector<int64_t> m_showLatencies;
 };
@@ -1,5 +1,11 @@
 #include "Output.h"
 
+#include <algorithm>
+#include <chrono>
+#include <thread>
+
+#include "FontWarmup.h"
+#include "Packing.h"
 #include "Registry.h"
 #include "ShellSurface.h"
 #include "spdlog/spdlog.h"
@@ -31,10 +37,27 @@ class Output {
         m_wloutput = nullptr;
     }
 
-    void Draw(const Registry &registry, const PanelConfig &panelConfig, BufferPool &bufferPool) {
+    // Returns surface to rasterize and submit or null if nothing should be drawn
+    ShellSurface *Render(const Registry &registry, const PanelConfig &panelConfig,
+                         const std::vector<bool> &dirtyWidgets) {
+        // Clean panels are only drawn when a previous draw has been deferred or when there is
+        // a rasterized frame waiting to be submitted. Panels without surface on this output are
+        // always drawn.
+        if (std::find(dirtyWidgets.begin(), dirtyWidgets.end(), true) == dirtyWidgets.end()) {
+            auto it = m_surfaces.find(panelConfig.index);
+            if (it != m_surfaces.end() && !it->second->HasDeferredDraw() &&
+                !it->second->HasRasterizedFrame()) {
+                return nullptr;
+            }
+        }
         // Query panel if it wants to be drawn on this display
         if (panelConfig.checkDisplay && !panelConfig.checkDisplay(m_name)) {
-            return;
+            // Hiding also drops a deferred draw that would otherwise be pending forever
+            auto it = m_surfaces.find(panelConfig.index);
+            if (it != m_surfaces.end()) {
+                it->second->Hide(registry, false);
+            }
+            return nullptr;
         }
         spdlog::info("Drawing panel {} on output {}", panelConfig.index, m_name);
         // Ensure that there is a surface for this panel
@@ -42,17 +65,122 @@ class Output {
             auto surface = ShellSurface::Create(registry, m_wloutput, panelConfig /* copies */);
             if (!surface) {
                 spdlog::error("Failed to create surface");
-                return;
+                return nullptr;
             }
             m_surfaces[panelConfig.index] = std::move(surface);
         }
-        m_surfaces[panelConfig.index]->Draw(registry, bufferPool, m_name);
+        auto surface = m_surfaces[panelConfig.index].get();
+        return surface->Render(m_name, dirtyWidgets) ? surface : nullptr;
+    }
+
+    void Hide(const Registry &registry, bool keepFrames) {
+        for (const auto &kv : m_surfaces) {
+            kv.second->Hide(registry, keepFrames);
+        }
+        if (m_atlasPool && !keepFrames) {
+            m_atlasPool->Purge();
+        }
+    }
+
+    // Renders all panels of the output when any of them needs to be drawn, they are all drawn in
+    // the same atlas buffer. Panels that are not displayed on the output are hidden. Returns true
+    // when the atlas should be rasterized and submitted.
+    bool RenderAtlas(const Registry &registry, const std::vector<std::vector<bool>> &dirtyWidgets) {
+        if (!m_atlasPool) {
+            m_atlasPool = BufferPool::Create(*registry.shm, 2, 3);
+        }
+        m_atlasSurfaces.clear();
+        bool needsDraw = false;
+        for (size_t i = 0; i < m_config->panels.size(); i++) {
+            const auto &panelConfig = m_config->panels[i];
+            auto it = m_surfaces.find(panelConfig.index);
+            if (panelConfig.checkDisplay && !panelConfig.checkDisplay(m_name)) {
+                // Would keep the previous atlas buffer from being released
+                if (it != m_surfaces.end()) {
+                    it->second->Hide(registry, false);
+                }
+                continue;
+            }
+            if (it == m_surfaces.end()) {
+                // Widgets are drawn in the atlas, not in subsurfaces
+                auto atlasPanelConfig = panelConfig;
+                atlasPanelConfig.subsurfaces = false;
+                auto surface = ShellSurface::Create(registry, m_wloutput, atlasPanelConfig);
+                if (!surface) {
+                    spdlog::error("Failed to create surface");
+                    continue;
+                }
+                surface->UseAtlas(registry, m_atlasPool.get());
+                it = m_surfaces.emplace(panelConfig.index, std::move(surface)).first;
+                needsDraw = true;
+            }
+            const auto &surface = it->second;
+            needsDraw = needsDraw || surface->HasDeferredDraw() ||
+                        surface->HasRasterizedFrame() ||
+                        std::find(dirtyWidgets[i].begin(), dirtyWidgets[i].end(), true) !=
+                            dirtyWidgets[i].end();
+            m_atlasSurfaces.emplace_back(surface.get(), i);
+        }
+        if (!needsDraw) {
+            m_atlasSurfaces.clear();
+            return false;
+        }
+        spdlog::info("Drawing {} panels in atlas on output {}", m_atlasSurfaces.size(), m_name);
+        // All panels are submitted together, when any of them is not ready all are deferred
+        bool isReady = true;
+        for (auto [surface, i] : m_atlasSurfaces) {
+            isReady = surface->Render(m_name, dirtyWidgets[i]) && isReady;
+        }
+        return isReady;
+    }
+
+    // Packs and draws the panels that were rendered, can be done on any thread.
+    void RasterAtlas() {
+        std::vector<Size> sizes;
+        bool needsRaster = false;
+        for (auto [surface, i] : m_atlasSurfaces) {
+            sizes.push_back(surface->Layout());
+            needsRaster = needsRaster || surface->NeedsRaster();
+        }
+        if (!needsRaster) {
+            // Kept from before, the atlas still contains all panels
+            return;
+        }
+        if (!std::equal(sizes.begin(), sizes.end(), m_packedSizes.begin(), m_packedSizes.end(),
+                        [](auto &a, auto &b) { return a.cx == b.cx && a.cy == b.cy; })) {
+            Pack(sizes);
+        }
+        auto buffer = m_atlasPool->Get(m_atlasSize.cx, m_atlasSize.cy);
+        if (!buffer) {
+            spdlog::debug("No atlas buffer to draw in");
+        }
+        for (size_t i = 0; i < m_atlasSurfaces.size(); i++) {
+            m_atlasSurfaces[i].first->RasterAtlas(buffer, m_packing[i]);
+        }
+    }
+
+    void SubmitAtlas(const Registry &registry) {
+        for (auto [surface, i] : m_atlasSurfaces) {
+            surface->Submit(registry);
+        }
     }
 
-    void Hide(const Registry &registry) {
+    bool HasDeferredDraws() const {
         for (const auto &kv : m_surfaces) {
-            kv.second->Hide(registry);
+            if (kv.second->HasDeferredDraw()) {
+                return true;
+            }
         }
+        return false;
+    }
+
+    bool HasPendingDraws() const {
+        for (const auto &kv : m_surfaces) {
+            if (kv.second->HasPendingDraw()) {
+                return true;
+            }
+        }
+        return false;
     }
 
     bool ClickSurface(wl_surface *surface, int x, int y) {
@@ -77,9 +205,23 @@ class Output {
         return false;
     }
 
+    void HoverSurface(wl_surface *surface, int x, int y) {
+        for (auto &kv : m_surfaces) {
+            kv.second->HoverSurface(surface, x, y);
+        }
+    }
+
    private:
     Output(wl_output *wloutput, std::shared_ptr<Configuration> config, OnNamedCallback onNamed)
-        : m_wloutput(wloutput), m_config(config), m_onNamed(onNamed) {}
+        : m_wloutput(wloutput), m_config(config), m_onNamed(onNamed), m_atlasSize{} {}
+
+    // Places panels on shelves ordered by height, the atlas is roughly square.
+    void Pack(const std::vector<Size> &sizes) {
+        m_atlasSize = PackShelves(sizes, m_packing);
+        m_packedSizes = sizes;
+        spdlog::debug("Packed {} panels on output {} in {}x{} atlas", sizes.size(), m_name,
+                      m_atlasSize.cx, m_atlasSize.cy);
+    }
 
     std::map<int, std::unique_ptr<ShellSurface>> m_surfaces;  // Surface per panel index
     wl_output *m_wloutput;
@@ -87,6 +229,14 @@ class Output {
     // Temporary callback until named, registers amoung the other outputs when name received
     OnNamedCallback m_onNamed;
     std::string m_name;
+    // Buffers shared by all panels when using an atlas
+    std::unique_ptr<BufferPool> m_atlasPool;
+    // Surfaces and their panel index to draw in the atlas
+    std::vector<std::pair<ShellSurface *, size_t>> m_atlasSurfaces;
+    // Sizes of panels when packed and where they were placed
+    std::vector<Size> m_packedSizes;
+    std::vector<Rect> m_packing;
+    Size m_atlasSize;
 };
 
 static void on_name(void *data, struct wl_output *, const char *name) {
@@ -118,17 +268,46 @@ const struct wl_output_listener listener = {
 };
 
 std::unique_ptr<Outputs> Outputs::Create(std::shared_ptr<Configuration> config) {
-    return std::unique_ptr<Outputs>(new Outputs(config));
+    // Main thread rasterizes as well
+    const int numThreads = std::clamp((int)std::thread::hardware_concurrency() - 1, 0, 3);
+    // Pango font maps are per thread, each worker loads the fonts before it rasterizes
+    auto workerPool = WorkerPool::Create(
+        numThreads, [fonts = config->fonts] { FontWarmup::WarmThread(fonts); });
+    return std::unique_ptr<Outputs>(new Outputs(config, std::move(workerPool)));
 }
 
-bool Outputs::InitializeBuffers(wl_shm &shm) {
-    m_bufferPool = BufferPool::Create(shm, m_config->numBuffers, m_config->bufferWidth,
-                                      m_config->bufferHeight);
-    if (!m_bufferPool) {
-        spdlog::error("Failed to initialize buffer pool");
-        return false;
+void Outputs::Raster(const std::vector<ShellSurface *> &surfaces) {
+    // Panels that render the same on multiple outputs are only rasterized once, the other
+    // outputs attach the same buffer.
+    std::map<size_t, ShellSurface *> rasterized;
+    std::vector<std::pair<ShellSurface *, ShellSurface *>> shared;
+    // Every surface has its own buffers and widgets, rasterize them in parallel
+    auto start = std::chrono::steady_clock::now();
+    std::vector<WorkerPool::Task> tasks;
+    for (auto surface : surfaces) {
+        auto [it, isNew] = rasterized.emplace(surface->RenderHash(), surface);
+        if (!isNew) {
+            shared.emplace_back(surface, it->second);
+            continue;
+        }
+        tasks.push_back([surface] { surface->Raster(); });
+    }
+    m_workerPool->Run(tasks);
+    for (auto &[surface, other] : shared) {
+        surface->Share(*other);
+    }
+    auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - start);
+    spdlog::debug("Rasterized {} of {} surfaces in {}us", tasks.size(), surfaces.size(),
+                  elapsed.count());
+}
+
+void Outputs::Submit(const Registry &registry, const std::vector<ShellSurface *> &surfaces) {
+    for (auto surface : surfaces) {
+        surface->Submit(registry);
     }
-    return true;
+    // Send all surface changes at once
+    registry.Flush();
 }
 
 void Outputs::Add(wl_output *wloutput) {
@@ -138,43 +317,133 @@ void Outputs::Add(wl_output *wloutput) {
     });
 }
 
-void Outputs::Draw(const Registry &registry, const Sources &sources) {
-    spdlog::trace("Draw outputs");
+std::vector<ShellSurface *> Outputs::Render(const Registry &registry, const Sources &sources) {
+    std::vector<ShellSurface *> surfaces;
     for (const auto &panelConfig : m_config->panels) {
-        bool dirty = false;
+        std::vector<bool> dirtyWidgets;
         for (const auto &widgetConfig : panelConfig.widgets) {
-            if (sources.NeedsRedraw(widgetConfig.sources)) {
-                dirty = true;
-                break;
-            }
+            dirtyWidgets.push_back(sources.NeedsRedraw(widgetConfig.sources));
         }
-        // This panel is dirty, redraw it on every output
-        if (dirty) {
-            for (const auto &nameAndOutput : m_map) {
-                nameAndOutput.second->Draw(registry, panelConfig, *m_bufferPool);
+        // When this panel is dirty, redraw it on every output. Otherwise only outputs that
+        // has a deferred draw of the panel.
+        for (const auto &nameAndOutput : m_map) {
+            auto surface = nameAndOutput.second->Render(registry, panelConfig, dirtyWidgets);
+            if (surface) {
+                surfaces.push_back(surface);
             }
         }
     }
+    return surfaces;
+}
+
+void Outputs::DrawAtlases(const Registry &registry, const Sources &sources, bool submit) {
+    std::vector<std::vector<bool>> dirtyWidgets;
+    for (const auto &panelConfig : m_config->panels) {
+        auto &dirty = dirtyWidgets.emplace_back();
+        for (const auto &widgetConfig : panelConfig.widgets) {
+            dirty.push_back(sources.NeedsRedraw(widgetConfig.sources));
+        }
+    }
+    std::vector<Output *> outputs;
+    for (const auto &nameAndOutput : m_map) {
+        if (nameAndOutput.second->RenderAtlas(registry, dirtyWidgets)) {
+            outputs.push_back(nameAndOutput.second.get());
+        }
+    }
+    // Every output has its own atlas
+    auto start = std::chrono::steady_clock::now();
+    std::vector<WorkerPool::Task> tasks;
+    for (auto output : outputs) {
+        tasks.push_back([output] { output->RasterAtlas(); });
+    }
+    m_workerPool->Run(tasks);
+    auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - start);
+    spdlog::debug("Rasterized {} atlases in {}us", outputs.size(), elapsed.count());
+    if (submit) {
+        for (auto output : outputs) {
+            output->SubmitAtlas(registry);
+        }
+    }
+    // Send all surface changes at once
+    registry.Flush();
+}
+
+bool Outputs::UsesAtlas(const Registry &registry) const {
+    if (m_config->atlas && !registry.viewporter) {
+        spdlog::debug("No viewporter, can not draw panels in atlas");
+    }
+    return m_config->atlas && registry.viewporter;
+}
+
+void Outputs::Draw(const Registry &registry, const Sources &sources) {
+    spdlog::trace("Draw outputs");
+    if (UsesAtlas(registry)) {
+        DrawAtlases(registry, sources, true);
+        return;
+    }
+    auto surfaces = Render(registry, sources);
+    Raster(surfaces);
+    Submit(registry, surfaces);
+}
+
+void Outputs::Prerender(const Registry &registry, const Sources &sources) {
+    spdlog::trace("Prerender outputs");
+    if (UsesAtlas(registry)) {
+        DrawAtlases(registry, sources, false);
+        return;
+    }
+    auto surfaces = Render(registry, sources);
+    Raster(surfaces);
+    // Surfaces might have been created
+    registry.Flush();
 }
 
 void Outputs::Hide(const Registry &registry) {
     for (auto &keyValue : m_map) {
-        keyValue.second->Hide(registry);
+        keyValue.second->Hide(registry, m_config->prerender);
     }
+    registry.Flush();
 }
 
 void Outputs::DrawAlert(const Registry &registry) {
     spdlog::info("Draw alert");
+    const auto dirtyWidgets = std::vector<bool>(m_config->alertPanel.widgets.size(), true);
+    std::vector<ShellSurface *> surfaces;
     for (const auto &nameAndOutput : m_map) {
-        nameAndOutput.second->Draw(registry, m_config->alertPanel, *m_bufferPool);
+        auto surface = nameAndOutput.second->Render(registry, m_config->alertPanel, dirtyWidgets);
+        if (surface) {
+            surfaces.push_back(surface);
+        }
     }
+    Raster(surfaces);
+    Submit(registry, surfaces);
 }
 
 void Outputs::HideAlert(const Registry &registry) {
     spdlog::info("Hide alert");
     for (const auto &nameAndOutput : m_map) {
-        nameAndOutput.second->Hide(registry);
+        nameAndOutput.second->Hide(registry, m_config->prerender);
     }
+    registry.Flush();
+}
+
+bool Outputs::HasDeferredDraws() const {
+    for (const auto &nameAndOutput : m_map) {
+        if (nameAndOutput.second->HasDeferredDraws()) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool Outputs::HasPendingDraws() const {
+    for (const auto &nameAndOutput : m_map) {
+        if (nameAndOutput.second->HasPendingDraws()) {
+            return true;
+        }
+    }
+    return false;
 }
 
 void Outputs::ClickSurface(wl_surface *surface, int x, int y) {
@@ -192,3 +461,9 @@ void Outputs::WheelSurface(wl_surface *surface, int x, int y, int value) {
         }
     }
 }
+
+void Outputs::HoverSurface(wl_surface *surface, int x, int y) {
+    for (auto &kv : m_map) {
+        kv.second->HoverSurface(surface, x, y);
+    }
+}
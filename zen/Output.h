@@ -6,32 +6,52 @@
 #include <map>
 #include <memory>
 #include <string>
+#include <vector>
 
 #include "zen/Buffer.h"
 #include "zen/Configuration.h"
 #include "zen/Sources/Sources.h"
+#include "zen/WorkerPool.h"
 
 class Output;
 class Registry;
-class BufferPool;
+class ShellSurface;
 
 class Outputs {
    public:
     static std::unique_ptr<Outputs> Create(std::shared_ptr<Configuration> config);
-    bool InitializeBuffers(wl_shm&);
     void Add(wl_output* output);
 
     void Draw(const Registry& registry, const Sources& sources);
+    // Renders and rasterizes changed panels without showing them, next draw submits them
+    // without rendering unless something changed again.
+    void Prerender(const Registry& registry, const Sources& sources);
     void Hide(const Registry& registry);
     void DrawAlert(const Registry& registry);
     void HideAlert(const Registry& registry);
+    // True when there are panels that should be redrawn now that the compositor is ready
+    bool HasDeferredDraws() const;
+    // True when there are panels with changes that are not committed yet
+    bool HasPendingDraws() const;
 
     void ClickSurface(wl_surface* surface, int x, int y);
     void WheelSurface(wl_surface* surface, int x, int y, int value);
+    // Every surface is told, surfaces that are not under the pointer clears their hover state
+    void HoverSurface(wl_surface* surface, int x, int y);
 
    private:
-    Outputs(std::shared_ptr<Configuration> config) : m_config(config) {}
+    Outputs(std::shared_ptr<Configuration> config, std::unique_ptr<WorkerPool> workerPool)
+        : m_config(config), m_workerPool(std::move(workerPool)) {}
+    // Renders panels that needs to be drawn and returns their surfaces
+    std::vector<ShellSurface*> Render(const Registry& registry, const Sources& sources);
+    void Raster(const std::vector<ShellSurface*>& surfaces);
+    void Submit(const Registry& registry, const std::vector<ShellSurface*>& surfaces);
+    // Draws all panels of each output in an atlas buffer per output, submit is false when
+    // prerendering.
+    void DrawAtlases(const Registry& registry, const Sources& sources, bool submit);
+    bool UsesAtlas(const Registry& registry) const;
+
     std::map<std::string, std::shared_ptr<Output>> m_map;
     const std::shared_ptr<Configuration> m_config;
-    std::unique_ptr<BufferPool> m_bufferPool;
+    std::unique_ptr<WorkerPool> m_workerPool;
 };
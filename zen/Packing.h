@@ -0,0 +1,41 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include "zen/RenderTree.h"
+
+// Places rectangles of sizes on shelves ordered by height, the packed area is roughly square.
+// Returns the size of the packed area, position of each size is stored at the same index in
+// packing. Zero sized rectangles still take a pixel.
+inline Size PackShelves(const std::vector<Size> &sizes, std::vector<Rect> &packing) {
+    std::vector<size_t> order(sizes.size());
+    int area = 0, maxCx = 1;
+    for (size_t i = 0; i < sizes.size(); i++) {
+        order[i] = i;
+        area += std::max(sizes[i].cx, 1) * std::max(sizes[i].cy, 1);
+        maxCx = std::max(maxCx, sizes[i].cx);
+    }
+    std::sort(order.begin(), order.end(),
+              [&sizes](auto a, auto b) { return sizes[a].cy > sizes[b].cy; });
+    const int width = std::max(maxCx, (int)std::ceil(std::sqrt(area)));
+    packing.resize(sizes.size());
+    Size packed{1, 1};
+    int x = 0, y = 0, shelfCy = 0;
+    for (auto i : order) {
+        const int cx = std::max(sizes[i].cx, 1);
+        const int cy = std::max(sizes[i].cy, 1);
+        if (x + cx > width) {
+            y += shelfCy;
+            x = 0;
+            shelfCy = 0;
+        }
+        packing[i] = Rect{x, y, cx, cy};
+        x += cx;
+        shelfCy = std::max(shelfCy, cy);
+        packed.cx = std::max(packed.cx, x);
+        packed.cy = std::max(packed.cy, y + shelfCy);
+    }
+    return packed;
+}
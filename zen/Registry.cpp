@@ -18,6 +18,8 @@
 //      - wl_seat version 5
 //      - wl_output version 4
 //      - wl_compositor version 4
+//      - wl_subcompositor version 1
+//      - wp_viewporter version 1
 void Registry::Register(struct wl_registry *registry, uint32_t name, const char *interface,
                         uint32_t version) {
     uint32_t wanted_version = 0;
@@ -34,12 +36,22 @@ void Registry::Register(struct wl_registry *registry, uint32_t name, const char
         // Defined in core wayland. There is a version 2 at time of writing..
         wanted_version = 1;
         build_version = wl_shm_interface.version;
-        this->m_shm = (wl_shm *)wl_registry_bind(registry, name, &wl_shm_interface, wanted_version);
+        this->shm = (wl_shm *)wl_registry_bind(registry, name, &wl_shm_interface, wanted_version);
     } else if (interface == std::string_view(wl_compositor_interface.name)) {
         wanted_version = 4;
         build_version = wl_compositor_interface.version;
         this->compositor = (wl_compositor *)wl_registry_bind(
             registry, name, &wl_compositor_interface, wanted_version);
+    } else if (interface == std::string_view(wl_subcompositor_interface.name)) {
+        wanted_version = 1;
+        build_version = wl_subcompositor_interface.version;
+        this->subcompositor = (wl_subcompositor *)wl_registry_bind(
+            registry, name, &wl_subcompositor_interface, wanted_version);
+    } else if (interface == std::string_view(wp_viewporter_interface.name)) {
+        wanted_version = 1;
+        build_version = wp_viewporter_interface.version;
+        this->viewporter = (wp_viewporter *)wl_registry_bind(
+            registry, name, &wp_viewporter_interface, wanted_version);
     } else if (interface == std::string_view(wl_output_interface.name)) {
         wanted_version = 4;
         build_version = wl_output_interface.version;
@@ -98,11 +110,18 @@ std::shared_ptr<Registry> Registry::Create(std::shared_ptr<MainLoop> mainLoop,
     wl_registry_add_listener(wlregistry, &listener, registry.get());
     // Two roundtrips, first to trigger registration, second to process binding requests.
     if (wl_display_roundtrip(display) < 0 || wl_display_roundtrip(display) < 0) return nullptr;
+    if (!registry->shm) {
+        spdlog::error("No shared memory interface");
+        return nullptr;
+    }
+    // Memory of new buffers is zeroed which is transparent
+    registry->hiddenBuffer = Buffer::Create(*registry->shm, 1, 1);
+    if (!registry->hiddenBuffer) {
+        spdlog::error("Failed to create buffer for hidden surfaces");
+        return nullptr;
+    }
     // Register in mainloop
-    mainLoop->RegisterIoHandler(wl_display_get_fd(display), "wayland", registry);
-    // Initialize buffers in outputs
-    if (!registry->m_outputs->InitializeBuffers(*registry->m_shm)) {
-        spdlog::error("Failed to initialize output buffers");
+    if (!mainLoop->RegisterIoHandler(wl_display_get_fd(display), "wayland", registry)) {
         return nullptr;
     }
     return registry;
@@ -113,10 +132,11 @@ bool Registry::OnRead() {
     wl_display_read_events(display);
     wl_display_dispatch_pending(display);
     wl_display_flush(display);
-    return false;
+    // Frame callbacks might have made deferred draws possible
+    return m_outputs->HasDeferredDraws();
 }
 
-void Registry::FlushAndDispatchCommands() const {
-    spdlog::trace("Flushing and dispatching wayland commands");
-    wl_display_roundtrip(display);
+void Registry::Flush() const {
+    spdlog::trace("Flushing wayland commands");
+    wl_display_flush(display);
 }
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <wayland-client-protocol.h>
+#include <viewporter.h>
 #include <wlr-layer-shell-unstable-v1.h>
 
 #include <cstdint>
@@ -21,8 +22,17 @@ class Registry : public IoHandler {
         m_registry = nullptr;
         zwlr_layer_shell_v1_destroy(shell);
         shell = nullptr;
-        wl_shm_destroy(m_shm);
-        m_shm = nullptr;
+        hiddenBuffer = nullptr;
+        wl_shm_destroy(shm);
+        shm = nullptr;
+        if (viewporter) {
+            wp_viewporter_destroy(viewporter);
+            viewporter = nullptr;
+        }
+        if (subcompositor) {
+            wl_subcompositor_destroy(subcompositor);
+            subcompositor = nullptr;
+        }
         wl_compositor_destroy(compositor);
         compositor = nullptr;
         // Should be last!
@@ -30,7 +40,8 @@ class Registry : public IoHandler {
         display = nullptr;
     }
 
-    void FlushAndDispatchCommands() const;
+    // Sends queued requests without waiting for the compositor
+    void Flush() const;
 
     void Register(struct wl_registry *registry, uint32_t name, const char *interface,
                   uint32_t version);
@@ -45,18 +56,26 @@ class Registry : public IoHandler {
     // Do not copy these!
     zwlr_layer_shell_v1 *shell;
     wl_compositor *compositor;
+    // Optional, panels draws all widgets in one surface without it
+    wl_subcompositor *subcompositor;
+    // Optional, panels can not share atlas buffers without it
+    wp_viewporter *viewporter;
+    wl_shm *shm;
     wl_display *display;
+    // Transparent 1x1 buffer attached to all hidden surfaces
+    std::shared_ptr<Buffer> hiddenBuffer;
 
    private:
     Registry(std::shared_ptr<MainLoop> mainloop, std::unique_ptr<Outputs> outputs,
              wl_display *display, wl_registry *registry)
         : m_outputs(std::move(outputs)), m_mainloop(mainloop), m_registry(registry) {
         this->display = display;
+        this->subcompositor = nullptr;
+        this->viewporter = nullptr;
     }
 
    private:
     std::unique_ptr<Outputs> m_outputs;
     std::shared_ptr<MainLoop> m_mainloop;  // Hmm, this is circular..
     wl_registry *m_registry;
-    wl_shm *m_shm;
 };
@@ -0,0 +1,747 @@
+#include "zen/RenderTree.h"
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+
+#include "pango/pangocairo.h"
+#include "spdlog/spdlog.h"
+#include "zen/FastText.h"
+#include "zen/ImageCache.h"
+#include "zen/LayoutCache.h"
+
+static void LogComputed(const Size& computed, const char* s) {
+    spdlog::trace("Computed {}: {}x{}", s, computed.cx, computed.cy);
+}
+
+static void LogDraw(const char* s, int x, int y) { spdlog::trace("Draw {}: {},{}", s, x, y); }
+
+static void ReleaseLayouts(std::vector<Node>& nodes) {
+    for (auto& node : nodes) {
+        if (node.layout) g_object_unref(node.layout);
+        node.layout = nullptr;
+        node.text = nullptr;
+        if (node.image) cairo_surface_destroy(node.image);
+        node.image = nullptr;
+    }
+}
+
+RenderTree::~RenderTree() {
+    ReleaseLayouts(m_nodes);
+    ReleaseLayouts(m_previous);
+}
+
+void RenderTree::Clear() {
+    if (m_isComputed) {
+        // Keep computed tree around to reuse the layout of unchanged subtrees
+        ReleaseLayouts(m_previous);
+        std::swap(m_nodes, m_previous);
+    } else {
+        ReleaseLayouts(m_nodes);
+    }
+    m_nodes.clear();
+    m_text.clear();
+    m_values.clear();
+    m_isComputed = false;
+}
+
+uint32_t RenderTree::Add(NodeType type) {
+    m_nodes.push_back(Node{.type = type,
+                           .markup = {},
+                           .tag = {},
+                           .path = {},
+                           .size = {},
+                           .value = 0,
+                           .values = {},
+                           .minValue = 0,
+                           .maxValue = 100,
+                           .lineWidth = 0,
+                           .color = {},
+                           .background = {},
+                           .hasHoverStyle = false,
+                           .hoverColor = {},
+                           .hoverBackground = {},
+                           .hoverBorderColor = {},
+                           .border = {},
+                           .radius = 0,
+                           .padding = {},
+                           .isColumn = false,
+                           .wrap = false,
+                           .justify = FlexJustify::Start,
+                           .align = FlexAlign::Start,
+                           .gap = 0,
+                           .grow = 0,
+                           .shrink = 1,
+                           .minSize = {},
+                           .maxSize = {},
+                           .firstChild = 0,
+                           .numChildren = 0,
+                           .hash = 0,
+                           .measured = {},
+                           .frame = {},
+                           .isArranged = false,
+                           .arrangedSize = {},
+                           .text = nullptr,
+                           .layout = nullptr,
+                           .image = nullptr});
+    return m_nodes.size() - 1;
+}
+
+uint32_t RenderTree::AddChildren(uint32_t parent, uint32_t numChildren) {
+    const uint32_t first = m_nodes.size();
+    for (uint32_t i = 0; i < numChildren; i++) {
+        Add(NodeType::Empty);
+    }
+    m_nodes[parent].firstChild = first;
+    m_nodes[parent].numChildren = numChildren;
+    return first;
+}
+
+TextRange RenderTree::AddText(std::string_view text) {
+    auto range = TextRange{.offset = (uint32_t)m_text.size(), .length = (uint32_t)text.size()};
+    m_text.append(text);
+    return range;
+}
+
+ValueRange RenderTree::AddValues(const std::vector<float>& values) {
+    auto range =
+        ValueRange{.offset = (uint32_t)m_values.size(), .length = (uint32_t)values.size()};
+    m_values.insert(m_values.end(), values.begin(), values.end());
+    return range;
+}
+
+static void HashPadding(size_t& hash, const Padding& padding) {
+    HashCombine(hash, padding.left);
+    HashCombine(hash, padding.right);
+    HashCombine(hash, padding.top);
+    HashCombine(hash, padding.bottom);
+}
+
+static void HashColor(size_t& hash, const RGBA& color) {
+    HashCombine(hash, std::hash<double>{}(color.r));
+    HashCombine(hash, std::hash<double>{}(color.g));
+    HashCombine(hash, std::hash<double>{}(color.b));
+    HashCombine(hash, std::hash<double>{}(color.a));
+}
+
+static void HashMeter(size_t& hash, const Node& node, std::span<const float> values) {
+    HashCombine(hash, node.size.cx);
+    HashCombine(hash, node.size.cy);
+    HashCombine(hash, std::hash<float>{}(node.value));
+    for (auto value : values) {
+        HashCombine(hash, std::hash<float>{}(value));
+    }
+    HashCombine(hash, std::hash<float>{}(node.minValue));
+    HashCombine(hash, std::hash<float>{}(node.maxValue));
+    HashColor(hash, node.color);
+    HashColor(hash, node.background);
+}
+
+void RenderTree::HashNodes() {
+    // Children are always stored after their parent, hashing backwards means that children are
+    // hashed before their parent.
+    for (size_t i = m_nodes.size(); i-- > 0;) {
+        auto& node = m_nodes[i];
+        size_t hash = (size_t)node.type;
+        // Any node can be an item of a flex container and be tagged
+        HashCombine(hash, node.grow);
+        HashCombine(hash, node.shrink);
+        HashCombine(hash, node.minSize.cx);
+        HashCombine(hash, node.minSize.cy);
+        HashCombine(hash, node.maxSize.cx);
+        HashCombine(hash, node.maxSize.cy);
+        HashCombine(hash, std::hash<std::string_view>{}(Text(node.tag)));
+        HashCombine(hash, node.hasHoverStyle);
+        if (node.hasHoverStyle) {
+            HashColor(hash, node.hoverColor);
+            HashColor(hash, node.hoverBackground);
+            HashColor(hash, node.hoverBorderColor);
+        }
+        // Properties that are not used by the type of the node are not hashed
+        switch (node.type) {
+            case NodeType::Empty:
+                break;
+            case NodeType::Markup:
+                HashCombine(hash, std::hash<std::string_view>{}(Text(node.markup)));
+                break;
+            case NodeType::Box:
+                HashCombine(hash, std::hash<std::string_view>{}(Text(node.markup)));
+                HashColor(hash, node.color);
+                HashColor(hash, node.border.color);
+                HashCombine(hash, node.border.width);
+                HashCombine(hash, node.radius);
+                HashPadding(hash, node.padding);
+                break;
+            case NodeType::Flex:
+                HashPadding(hash, node.padding);
+                HashCombine(hash, node.isColumn);
+                HashCombine(hash, node.wrap);
+                HashCombine(hash, (size_t)node.justify);
+                HashCombine(hash, (size_t)node.align);
+                HashCombine(hash, node.gap);
+                break;
+            case NodeType::Image:
+                HashCombine(hash, std::hash<std::string_view>{}(Text(node.path)));
+                HashCombine(hash, node.size.cx);
+                HashCombine(hash, node.size.cy);
+                break;
+            case NodeType::Bar:
+                HashMeter(hash, node, {});
+                HashCombine(hash, node.radius);
+                HashCombine(hash, node.isColumn);
+                break;
+            case NodeType::Gauge:
+                HashMeter(hash, node, {});
+                HashCombine(hash, node.lineWidth);
+                break;
+            case NodeType::Sparkline:
+                HashMeter(hash, node, Values(node.values));
+                HashCombine(hash, node.lineWidth);
+                break;
+        }
+        HashCombine(hash, node.numChildren);
+        for (uint32_t c = node.firstChild; c < node.firstChild + node.numChildren; c++) {
+            HashCombine(hash, m_nodes[c].hash);
+        }
+        node.hash = hash;
+    }
+}
+
+void RenderTree::Compute(cairo_t* cr) {
+    m_isComputed = true;
+    if (m_nodes.empty()) {
+        return;
+    }
+    m_numMeasured = 0;
+    m_numReused = 0;
+    Measure(0, m_previous.empty() ? none : 0, cr);
+    auto& root = m_nodes[0];
+    root.frame = Rect{.x = 0, .y = 0, .cx = root.measured.cx, .cy = root.measured.cy};
+    Arrange(0);
+    // Layouts that were not reused are not needed anymore
+    ReleaseLayouts(m_previous);
+    m_previous.clear();
+    spdlog::trace("Computed tree, measured {} and reused {} of {} nodes", m_numMeasured,
+                  m_numReused, m_nodes.size());
+}
+
+static int Main(const Size& size, bool isColumn) { return isColumn ? size.cy : size.cx; }
+
+static int Cross(const Size& size, bool isColumn) { return isColumn ? size.cx : size.cy; }
+
+static int MainPadding(const Padding& padding, bool isColumn) {
+    return isColumn ? padding.top + padding.bottom : padding.left + padding.right;
+}
+
+static int CrossPadding(const Padding& padding, bool isColumn) {
+    return isColumn ? padding.left + padding.right : padding.top + padding.bottom;
+}
+
+static int Clamp(int value, int min, int max) {
+    if (max > 0) value = std::min(value, max);
+    return std::max(value, min);
+}
+
+static Size ClampSize(const Size& size, const Node& node) {
+    return Size{Clamp(size.cx, node.minSize.cx, node.maxSize.cx),
+                Clamp(size.cy, node.minSize.cy, node.maxSize.cy)};
+}
+
+static Size ComputeMarkup(const std::string_view markup, cairo_t* cr, Node& node) {
+    // pango_layout_set_width(m_layout, m_config.cx * PANGO_SCALE);
+    // pango_layout_set_height(m_layout, m_config.cy * PANGO_SCALE);
+    auto& layout = node.layout;
+    if (layout) g_object_unref(layout);
+    layout = nullptr;
+    node.text = FastText::ForThread().Get(cr, markup);
+    if (node.text) {
+        return node.text->size;
+    }
+    layout = LayoutCache::ForThread().Get(cr, markup);
+    PangoRectangle rect;
+    pango_layout_get_extents(layout, nullptr, &rect);
+    pango_extents_to_pixels(&rect, nullptr);
+    return Size{rect.width, rect.height};
+}
+
+void RenderTree::Reuse(uint32_t index, uint32_t previous, cairo_t* cr) {
+    auto& node = m_nodes[index];
+    const auto& old = m_previous[previous];
+    node.measured = old.measured;
+    node.frame = old.frame;
+    node.isArranged = old.isArranged;
+    node.arrangedSize = old.arrangedSize;
+    // Only the geometry is kept. The previous tree might have been measured by another thread
+    // and its layouts belong to the caches of that thread, these lookups are cache hits.
+    switch (node.type) {
+        case NodeType::Markup:
+        case NodeType::Box:
+            ComputeMarkup(Text(node.markup), cr, node);
+            break;
+        case NodeType::Image: {
+            Size drawnSize;
+            node.image = ImageCache::ForThread().Get(cr, Text(node.path), node.size, drawnSize);
+            break;
+        }
+        default:
+            break;
+    }
+    m_numReused++;
+    const auto numChildren = std::min(node.numChildren, old.numChildren);
+    for (uint32_t i = 0; i < numChildren; i++) {
+        Reuse(node.firstChild + i, old.firstChild + i, cr);
+    }
+}
+
+uint32_t RenderTree::NextLine(const Node& node, uint32_t first, int maxMain, Size& line) const {
+    const uint32_t end = node.firstChild + node.numChildren;
+    int main = 0, cross = 0, numItems = 0;
+    uint32_t i = first;
+    for (; i < end; i++) {
+        const auto& child = m_nodes[i];
+        if (child.type == NodeType::Empty) continue;
+        const int itemMain = Main(child.measured, node.isColumn) +
+                             MainPadding(node.padding, node.isColumn) +
+                             (numItems > 0 ? node.gap : 0);
+        if (node.wrap && maxMain > 0 && numItems > 0 && main + itemMain > maxMain) {
+            break;
+        }
+        main += itemMain;
+        cross = std::max(cross, Cross(child.measured, node.isColumn) +
+                                    CrossPadding(node.padding, node.isColumn));
+        numItems++;
+    }
+    line = node.isColumn ? Size{cross, main} : Size{main, cross};
+    return i;
+}
+
+void RenderTree::Measure(uint32_t index, uint32_t previous, cairo_t* cr) {
+    auto& node = m_nodes[index];
+    if (previous != none && m_previous[previous].hash == node.hash) {
+        // Nothing in the subtree changed
+        Reuse(index, previous, cr);
+        return;
+    }
+    m_numMeasured++;
+    node.isArranged = false;
+    auto& measured = node.measured;
+    switch (node.type) {
+        case NodeType::Empty:
+            measured = Size{};
+            return;
+        case NodeType::Markup:
+            measured = ClampSize(ComputeMarkup(Text(node.markup), cr, node), node);
+            LogComputed(measured, "Markup");
+            return;
+        case NodeType::Box:
+            measured = ComputeMarkup(Text(node.markup), cr, node);
+            measured.cx += node.padding.left + node.padding.right + (2 * node.border.width);
+            measured.cy += node.padding.top + node.padding.bottom + (2 * node.border.width);
+            measured = ClampSize(measured, node);
+            LogComputed(measured, "Box");
+            return;
+        case NodeType::Image:
+            if (node.image) cairo_surface_destroy(node.image);
+            node.image = ImageCache::ForThread().Get(cr, Text(node.path), node.size, measured);
+            if (!node.image) measured = Size{};
+            measured = ClampSize(measured, node);
+            LogComputed(measured, "Image");
+            return;
+        case NodeType::Bar:
+        case NodeType::Gauge:
+        case NodeType::Sparkline:
+            measured = ClampSize(node.size, node);
+            LogComputed(measured, "Meter");
+            return;
+        case NodeType::Flex:
+            break;
+    }
+    // Children are paired with children at the same position in the previous tree
+    const auto* old = previous != none ? &m_previous[previous] : nullptr;
+    for (uint32_t i = 0; i < node.numChildren; i++) {
+        const auto oldChild = old && i < old->numChildren ? old->firstChild + i : none;
+        Measure(node.firstChild + i, oldChild, cr);
+    }
+    // Lines are placed after each other along the cross axis
+    const int maxMain = Main(node.maxSize, node.isColumn);
+    const uint32_t end = node.firstChild + node.numChildren;
+    int main = 0, cross = 0, numLines = 0;
+    for (uint32_t first = node.firstChild; first < end;) {
+        Size line;
+        first = NextLine(node, first, maxMain, line);
+        main = std::max(main, Main(line, node.isColumn));
+        cross += Cross(line, node.isColumn) + (numLines > 0 ? node.gap : 0);
+        numLines++;
+    }
+    measured = ClampSize(node.isColumn ? Size{cross, main} : Size{main, cross}, node);
+    LogComputed(measured, "Flex");
+}
+
+void RenderTree::Arrange(uint32_t index) {
+    auto& node = m_nodes[index];
+    const Size size{node.frame.cx, node.frame.cy};
+    if (node.isArranged && node.arrangedSize.cx == size.cx && node.arrangedSize.cy == size.cy) {
+        return;
+    }
+    node.isArranged = true;
+    node.arrangedSize = size;
+    if (node.type != NodeType::Flex) {
+        return;
+    }
+    const int availMain = Main(size, node.isColumn);
+    const uint32_t end = node.firstChild + node.numChildren;
+    // A single line fills the container, multiple lines are as thick as their thickest item
+    Size line;
+    const bool isSingleLine = NextLine(node, node.firstChild, availMain, line) == end;
+    int cross = 0;
+    for (uint32_t first = node.firstChild; first < end;) {
+        const auto last = NextLine(node, first, availMain, line);
+        const int lineCross =
+            isSingleLine ? Cross(size, node.isColumn) : Cross(line, node.isColumn);
+        ArrangeLine(node, first, last, Main(line, node.isColumn), cross, lineCross);
+        cross += lineCross + node.gap;
+        first = last;
+    }
+    for (uint32_t i = node.firstChild; i < end; i++) {
+        Arrange(i);
+    }
+}
+
+void RenderTree::ArrangeLine(const Node& node, uint32_t first, uint32_t end, int lineMain,
+                             int cross, int lineCross) {
+    const bool isColumn = node.isColumn;
+    const int availMain = Main(Size{node.frame.cx, node.frame.cy}, isColumn);
+    // Sizes along main axis starts as measured and free space is given to or taken from items
+    // that grows or shrinks.
+    int free = availMain - lineMain;
+    int numItems = 0, totalGrow = 0, totalShrink = 0;
+    for (uint32_t i = first; i < end; i++) {
+        const auto& child = m_nodes[i];
+        if (child.type == NodeType::Empty) continue;
+        numItems++;
+        totalGrow += child.grow;
+        totalShrink += child.shrink * Main(child.measured, isColumn);
+    }
+    const int toDistribute = free;
+    for (uint32_t i = first; i < end; i++) {
+        auto& child = m_nodes[i];
+        if (child.type == NodeType::Empty) {
+            child.frame = Rect{};
+            continue;
+        }
+        const int measuredMain = Main(child.measured, isColumn);
+        int itemMain = measuredMain;
+        if (toDistribute > 0 && totalGrow > 0) {
+            itemMain += toDistribute * child.grow / totalGrow;
+        } else if (toDistribute < 0 && totalShrink > 0) {
+            itemMain += (long)toDistribute * child.shrink * measuredMain / totalShrink;
+        }
+        itemMain = std::max(Clamp(itemMain, Main(child.minSize, isColumn),
+                                  Main(child.maxSize, isColumn)),
+                            0);
+        free -= itemMain - measuredMain;
+        int itemCross = Cross(child.measured, isColumn);
+        if (node.align == FlexAlign::Stretch) {
+            itemCross = Clamp(lineCross - CrossPadding(node.padding, isColumn),
+                              Cross(child.minSize, isColumn), Cross(child.maxSize, isColumn));
+        }
+        auto& frame = child.frame;
+        if (isColumn) {
+            frame.cx = itemCross;
+            frame.cy = itemMain;
+        } else {
+            frame.cx = itemMain;
+            frame.cy = itemCross;
+        }
+    }
+    // Remaining free space is used for justification
+    free = std::max(free, 0);
+    int pos = 0, between = 0;
+    switch (node.justify) {
+        case FlexJustify::Start:
+            break;
+        case FlexJustify::End:
+            pos = free;
+            break;
+        case FlexJustify::Center:
+            pos = free / 2;
+            break;
+        case FlexJustify::SpaceBetween:
+            between = numItems > 1 ? free / (numItems - 1) : 0;
+            break;
+        case FlexJustify::SpaceAround:
+            between = numItems > 0 ? free / numItems : 0;
+            pos = between / 2;
+            break;
+        case FlexJustify::SpaceEvenly:
+            between = free / (numItems + 1);
+            pos = between;
+            break;
+    }
+    const auto& padding = node.padding;
+    const int mainStart = isColumn ? padding.top : padding.left;
+    const int crossStart = isColumn ? padding.left : padding.top;
+    for (uint32_t i = first; i < end; i++) {
+        auto& child = m_nodes[i];
+        if (child.type == NodeType::Empty) continue;
+        const Size itemSize{child.frame.cx, child.frame.cy};
+        const int outerCross = Cross(itemSize, isColumn) + CrossPadding(padding, isColumn);
+        int offset = 0;
+        switch (node.align) {
+            case FlexAlign::Start:
+            case FlexAlign::Stretch:
+                break;
+            case FlexAlign::End:
+                offset = lineCross - outerCross;
+                break;
+            case FlexAlign::Center:
+                offset = (lineCross - outerCross) / 2;
+                break;
+        }
+        const int mainPos = pos + mainStart;
+        const int crossPos = cross + offset + crossStart;
+        child.frame.x = isColumn ? crossPos : mainPos;
+        child.frame.y = isColumn ? mainPos : crossPos;
+        pos += Main(itemSize, isColumn) + MainPadding(padding, isColumn) + node.gap + between;
+    }
+}
+
+void RenderTree::Draw(cairo_t* cr, int x, int y, std::string_view hover,
+                      std::vector<Target>& targets) const {
+    if (m_nodes.empty()) {
+        return;
+    }
+    double x1, y1, x2, y2;
+    cairo_clip_extents(cr, &x1, &y1, &x2, &y2);
+    const auto clip = Rect{.x = (int)std::floor(x1),
+                           .y = (int)std::floor(y1),
+                           .cx = (int)std::ceil(x2 - std::floor(x1)),
+                           .cy = (int)std::ceil(y2 - std::floor(y1))};
+    Draw(0, cr, x, y, clip, hover, targets);
+}
+
+bool RenderTree::HasHoverStyle(std::string_view tag) const {
+    if (tag.empty()) {
+        return false;
+    }
+    return std::any_of(m_nodes.begin(), m_nodes.end(), [this, tag](const Node& node) {
+        return node.hasHoverStyle && Text(node.tag) == tag;
+    });
+}
+
+// Node with colors replaced by the hover style, scratch holds the copy when needed
+static const Node& Styled(const Node& node, std::string_view hover, std::string_view tag,
+                          Node& scratch) {
+    if (!node.hasHoverStyle || hover.empty() || tag != hover) {
+        return node;
+    }
+    scratch = node;
+    scratch.color = node.hoverColor;
+    scratch.background = node.hoverBackground;
+    scratch.border.color = node.hoverBorderColor;
+    return scratch;
+}
+
+static void BeginRectangleSubPath(cairo_t* cr, int x, int y, int cx, int cy, int radius) {
+    constexpr double degrees = M_PI / 180.0;
+    cairo_new_sub_path(cr);
+    // A-----B
+    // |     |
+    // C-----D
+    // B
+    cairo_arc(cr, x + cx - radius, y + radius, radius, -90 * degrees, 0 * degrees);
+    // D
+    cairo_arc(cr, x + cx - radius, y + cy - radius, radius, 0 * degrees, 90 * degrees);
+    // C
+    cairo_arc(cr, x + radius, y + cy - radius, radius, 90 * degrees, 180 * degrees);
+    // A
+    cairo_arc(cr, x + radius, y + radius, radius, 180 * degrees, 270 * degrees);
+    cairo_close_path(cr);
+}
+
+static void DrawMarkup(const Node& node, cairo_t* cr, int x, int y) {
+    if (node.text) {
+        FastText::ForThread().Draw(cr, *node.text, x, y);
+        return;
+    }
+    cairo_move_to(cr, x, y);
+    pango_cairo_show_layout(cr, node.layout);
+}
+
+static void DrawImage(const Node& node, cairo_t* cr, int x, int y) {
+    if (!node.image) return;
+    // Cropped when the frame is smaller than the image
+    cairo_set_source_surface(cr, node.image, x, y);
+    cairo_rectangle(cr, x, y, node.frame.cx, node.frame.cy);
+    cairo_fill(cr);
+}
+
+// Position of value between min and max, 0 to 1
+static double Fraction(const Node& node, float value) {
+    if (node.maxValue <= node.minValue) return 0;
+    return std::clamp((value - node.minValue) / (node.maxValue - node.minValue), 0.0f, 1.0f);
+}
+
+static void SetSource(cairo_t* cr, const RGBA& color) {
+    cairo_set_source_rgba(cr, color.r, color.g, color.b, color.a);
+}
+
+static void DrawBar(const Node& node, cairo_t* cr, int x, int y) {
+    const auto& frame = node.frame;
+    const int radius = std::min({(int)node.radius, frame.cx / 2, frame.cy / 2});
+    BeginRectangleSubPath(cr, x, y, frame.cx, frame.cy, radius);
+    SetSource(cr, node.background);
+    cairo_fill(cr);
+    // Filled from left in a row, from bottom in a column
+    const auto fraction = Fraction(node, node.value);
+    cairo_save(cr);
+    if (node.isColumn) {
+        const int cy = std::lround(frame.cy * fraction);
+        cairo_rectangle(cr, x, y + frame.cy - cy, frame.cx, cy);
+    } else {
+        cairo_rectangle(cr, x, y, std::lround(frame.cx * fraction), frame.cy);
+    }
+    cairo_clip(cr);
+    BeginRectangleSubPath(cr, x, y, frame.cx, frame.cy, radius);
+    SetSource(cr, node.color);
+    cairo_fill(cr);
+    cairo_restore(cr);
+}
+
+static void DrawGauge(const Node& node, cairo_t* cr, int x, int y) {
+    // Arc open at the bottom, filled clockwise
+    constexpr double start = 0.75 * M_PI;
+    constexpr double sweep = 1.5 * M_PI;
+    const auto& frame = node.frame;
+    const double lineWidth = node.lineWidth;
+    const double radius = (std::min(frame.cx, frame.cy) - lineWidth) / 2;
+    if (radius <= 0) return;
+    const double centerX = x + frame.cx / 2.0;
+    const double centerY = y + frame.cy / 2.0;
+    cairo_set_line_width(cr, lineWidth);
+    cairo_new_path(cr);
+    cairo_arc(cr, centerX, centerY, radius, start, start + sweep);
+    SetSource(cr, node.background);
+    cairo_stroke(cr);
+    const auto fraction = Fraction(node, node.value);
+    if (fraction <= 0) return;
+    cairo_arc(cr, centerX, centerY, radius, start, start + sweep * fraction);
+    SetSource(cr, node.color);
+    cairo_stroke(cr);
+}
+
+static void DrawSparkline(const Node& node, std::span<const float> values, cairo_t* cr, int x,
+                          int y) {
+    if (values.size() < 2) return;
+    const auto& frame = node.frame;
+    const double lineWidth = node.lineWidth;
+    // Line is kept within the frame
+    const double top = y + lineWidth / 2;
+    const double height = frame.cy - lineWidth;
+    const double step = (double)frame.cx / (values.size() - 1);
+    auto trace = [&]() {
+        cairo_new_path(cr);
+        for (size_t i = 0; i < values.size(); i++) {
+            cairo_line_to(cr, x + i * step, top + height * (1 - Fraction(node, values[i])));
+        }
+    };
+    if (node.background.a > 0) {
+        trace();
+        cairo_line_to(cr, x + frame.cx, y + frame.cy);
+        cairo_line_to(cr, x, y + frame.cy);
+        cairo_close_path(cr);
+        SetSource(cr, node.background);
+        cairo_fill(cr);
+    }
+    trace();
+    cairo_set_line_width(cr, lineWidth);
+    SetSource(cr, node.color);
+    cairo_stroke(cr);
+}
+
+static void DrawBox(const Node& node, cairo_t* cr, int x, int y) {
+    const auto& border = node.border;
+    const auto& frame = node.frame;
+    const int innerCx = frame.cx - (2 * border.width);
+    const int innerCy = frame.cy - (2 * border.width);
+    // Border
+    if (border.width) {
+        // Area between outer and inner rectangle, the outer corners follows the inner ones.
+        const int outerRadius = node.radius ? node.radius + border.width : 0;
+        BeginRectangleSubPath(cr, x, y, frame.cx, frame.cy, outerRadius);
+        BeginRectangleSubPath(cr, x + border.width, y + border.width, innerCx, innerCy,
+                              node.radius);
+        cairo_set_fill_rule(cr, CAIRO_FILL_RULE_EVEN_ODD);
+        cairo_set_source_rgba(cr, border.color.r, border.color.g, border.color.b, border.color.a);
+        cairo_fill(cr);
+        cairo_set_fill_rule(cr, CAIRO_FILL_RULE_WINDING);
+    }
+    // Fill
+    BeginRectangleSubPath(cr, x + border.width, y + border.width, innerCx, innerCy, node.radius);
+    cairo_set_source_rgba(cr, node.color.r, node.color.g, node.color.b, node.color.a);
+    cairo_fill(cr);
+    // Inner
+    DrawMarkup(node, cr, x + node.padding.left + border.width, y + node.padding.top + border.width);
+}
+
+void RenderTree::AddTarget(const Node& node, int x, int y, std::vector<Target>& targets) const {
+    if (node.tag.length == 0) {
+        return;
+    }
+    targets.push_back(
+        Target{.position = Rect{.x = x, .y = y, .cx = node.frame.cx, .cy = node.frame.cy},
+               .tag = std::string(Text(node.tag))});
+}
+
+void RenderTree::Draw(uint32_t index, cairo_t* cr, int x, int y, const Rect& clip,
+                      std::string_view hover, std::vector<Target>& targets) const {
+    const auto& node = m_nodes[index];
+    if (node.type != NodeType::Flex &&
+        !clip.Intersects(Rect{.x = x, .y = y, .cx = node.frame.cx, .cy = node.frame.cy})) {
+        // Children of flex containers might be placed outside of it, only leaves are skipped
+        return;
+    }
+    Node scratch;
+    const auto& styled = Styled(node, hover, Text(node.tag), scratch);
+    switch (node.type) {
+        case NodeType::Empty:
+            return;
+        case NodeType::Markup:
+            LogDraw("Markup", x, y);
+            DrawMarkup(node, cr, x, y);
+            return;
+        case NodeType::Box:
+            LogDraw("Box", x, y);
+            DrawBox(styled, cr, x, y);
+            AddTarget(node, x, y, targets);
+            return;
+        case NodeType::Image:
+            LogDraw("Image", x, y);
+            DrawImage(node, cr, x, y);
+            AddTarget(node, x, y, targets);
+            return;
+        case NodeType::Bar:
+            LogDraw("Bar", x, y);
+            DrawBar(styled, cr, x, y);
+            AddTarget(node, x, y, targets);
+            return;
+        case NodeType::Gauge:
+            LogDraw("Gauge", x, y);
+            DrawGauge(styled, cr, x, y);
+            AddTarget(node, x, y, targets);
+            return;
+        case NodeType::Sparkline:
+            LogDraw("Sparkline", x, y);
+            DrawSparkline(styled, Values(node.values), cr, x, y);
+            AddTarget(node, x, y, targets);
+            return;
+        case NodeType::Flex:
+            break;
+    }
+    LogDraw("Flex", x, y);
+    for (uint32_t i = node.firstChild; i < node.firstChild + node.numChildren; i++) {
+        const auto& child = m_nodes[i];
+        Draw(i, cr, x + child.frame.x, y + child.frame.y, clip, hover, targets);
+    }
+    AddTarget(node, x, y, targets);
+}
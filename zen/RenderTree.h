@@ -0,0 +1,230 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "cairo.h"
+#include "pango/pango-layout.h"
+
+struct ShapedText;
+
+struct Padding {
+    int left;
+    int right;
+    int top;
+    int bottom;
+};
+
+struct Size {
+    int cx;
+    int cy;
+
+    bool operator==(const Size&) const = default;
+};
+
+struct Rect {
+    int x;
+    int y;
+    int cx;
+    int cy;
+
+    bool Contains(int x_, int y_) const {
+        return x_ >= x && x_ <= x + cx && y_ >= y && y_ <= y + cy;
+    }
+    bool Intersects(const Rect& o) const {
+        return x < o.x + o.cx && o.x < x + cx && y < o.y + o.cy && o.y < y + cy;
+    }
+    bool operator==(const Rect&) const = default;
+};
+
+struct RGBA {
+    double r;
+    double g;
+    double b;
+    double a;
+    static RGBA FromString(const std::string& s);
+};
+
+struct Border {
+    RGBA color;
+    int width;
+};
+
+struct Target {
+    Rect position;
+    std::string tag;
+};
+
+inline void HashCombine(size_t& hash, size_t value) {
+    hash ^= value + 0x9e3779b9 + (hash << 6) + (hash >> 2);
+}
+
+enum class NodeType : uint8_t {
+    // Placeholder for something that could not be parsed, takes no space
+    Empty,
+    Markup,
+    Box,
+    Flex,
+    Image,
+    Bar,
+    Gauge,
+    Sparkline,
+};
+
+// Distribution of free space along the main axis of a flex container
+enum class FlexJustify : uint8_t { Start, End, Center, SpaceBetween, SpaceAround, SpaceEvenly };
+
+// Placement of items along the cross axis of a flex container
+enum class FlexAlign : uint8_t { Start, End, Center, Stretch };
+
+// Part of the text of a tree
+struct TextRange {
+    uint32_t offset;
+    uint32_t length;
+};
+
+// Part of the values of a tree
+struct ValueRange {
+    uint32_t offset;
+    uint32_t length;
+};
+
+// All types of nodes share the same struct, properties that does not apply to a type are unused.
+struct Node {
+    NodeType type;
+    // Markup of markup and box nodes
+    TextRange markup;
+    // Tag of box, flex, image, bar, gauge and sparkline nodes
+    TextRange tag;
+    // Image file
+    TextRange path;
+    // Size to draw image, bar, gauge and sparkline nodes in, 0 in a dimension of an image means
+    // from the image
+    Size size;
+    // Value of a bar or gauge, samples of a sparkline. Shown relative to min and max.
+    float value;
+    ValueRange values;
+    float minValue;
+    float maxValue;
+    // Width of gauge arc and sparkline
+    int lineWidth;
+    // Fill of box, filled part of bar and gauge, line of sparkline
+    RGBA color;
+    // Unfilled part of bar and gauge, area below sparkline
+    RGBA background;
+    // Replaces colors when the pointer is over a target with the tag of the node
+    bool hasHoverStyle;
+    RGBA hoverColor;
+    RGBA hoverBackground;
+    RGBA hoverBorderColor;
+    Border border;
+    uint8_t radius;
+    // Inside border of a box, around every item of a flex container
+    Padding padding;
+    // Flex container
+    bool isColumn;
+    bool wrap;
+    FlexJustify justify;
+    FlexAlign align;
+    int gap;
+    // As item in a flex container
+    uint8_t grow;
+    uint8_t shrink;
+    // Limits of the size, 0 in max means no limit
+    Size minSize;
+    Size maxSize;
+    // Children are stored after each other
+    uint32_t firstChild;
+    uint32_t numChildren;
+    // Hash of node and all nodes below
+    size_t hash;
+    // Set by compute. Measured is the size the node wants, frame is where the node is placed
+    // relative to the parent and the size it got.
+    Size measured;
+    Rect frame;
+    // Size that children were arranged in
+    bool isArranged;
+    Size arrangedSize;
+    // Markup is either shaped by the fast text path or laid out by Pango
+    std::shared_ptr<const ShapedText> text;
+    PangoLayout* layout;
+    cairo_surface_t* image;
+};
+
+// Render tree stored as a flat array of nodes where the root is the first node. The storage is
+// kept when the tree is cleared so rendering a tree again does not allocate unless it grows.
+// The previously computed tree is kept until the next compute, subtrees that did not change
+// reuse the layout from the previous tree.
+class RenderTree {
+   public:
+    RenderTree() : m_isComputed(false), m_numMeasured(0), m_numReused(0) {}
+    RenderTree(const RenderTree&) = delete;
+    RenderTree& operator=(const RenderTree&) = delete;
+    RenderTree(RenderTree&&) = default;
+    RenderTree& operator=(RenderTree&&) = default;
+    virtual ~RenderTree();
+
+    void Clear();
+    bool IsEmpty() const { return m_nodes.empty(); }
+
+    // Building. Adds a node or a range of child nodes to be filled in, returns index of first
+    // added node. References to nodes are invalidated when nodes are added.
+    uint32_t Add(NodeType type);
+    uint32_t AddChildren(uint32_t parent, uint32_t numChildren);
+    TextRange AddText(std::string_view text);
+    ValueRange AddValues(const std::vector<float>& values);
+    Node& At(uint32_t index) { return m_nodes[index]; }
+    std::string_view Text(TextRange range) const {
+        return std::string_view(m_text).substr(range.offset, range.length);
+    }
+    std::span<const float> Values(ValueRange range) const {
+        return std::span<const float>(m_values).subspan(range.offset, range.length);
+    }
+
+    // Hashes all nodes, call when the tree is built
+    void HashNodes();
+    // Measures and arranges all nodes
+    void Compute(cairo_t* cr);
+    // Nodes tagged with hover are drawn with their hover style. Only nodes within the clip of cr
+    // are drawn and have their targets added.
+    void Draw(cairo_t* cr, int x, int y, std::string_view hover,
+              std::vector<Target>& targets) const;
+    // Equal hashes means that trees draws the same
+    size_t Hash() const { return m_nodes.empty() ? 0 : m_nodes[0].hash; }
+    Size Computed() const {
+        return m_nodes.empty() ? Size{} : Size{m_nodes[0].frame.cx, m_nodes[0].frame.cy};
+    }
+    size_t NumNodes() const { return m_nodes.size(); }
+    // True when a node tagged with tag has a hover style
+    bool HasHoverStyle(std::string_view tag) const;
+
+   private:
+    // Index in previous tree of nodes that has no corresponding node
+    static constexpr uint32_t none = UINT32_MAX;
+
+    void Measure(uint32_t index, uint32_t previous, cairo_t* cr);
+    void Reuse(uint32_t index, uint32_t previous, cairo_t* cr);
+    // Places children of node within the frame of the node
+    void Arrange(uint32_t index);
+    // Items of a flex container that fits on one line starting at first, returns end of line
+    uint32_t NextLine(const Node& node, uint32_t first, int maxMain, Size& line) const;
+    void ArrangeLine(const Node& node, uint32_t first, uint32_t end, int lineMain, int cross,
+                     int lineCross);
+    void Draw(uint32_t index, cairo_t* cr, int x, int y, const Rect& clip, std::string_view hover,
+              std::vector<Target>& targets) const;
+    void AddTarget(const Node& node, int x, int y, std::vector<Target>& targets) const;
+
+    std::vector<Node> m_nodes;
+    // Text of all nodes
+    std::string m_text;
+    // Values of all nodes
+    std::vector<float> m_values;
+    bool m_isComputed;
+    std::vector<Node> m_previous;
+    int m_numMeasured;
+    int m_numReused;
+};
@@ -1,6 +1,10 @@
 
 #include "zen/ScriptContext.h"
 
+#include <map>
+
+#include "zen/History.h"
+
 #include "sol/sol.hpp"
 #include "spdlog/spdlog.h"
 #include "util.h"
@@ -36,70 +40,218 @@ Padding PaddingFromProperty(const sol::table& t, const char* name) {
     return o ? PaddingFromTable(*o) : Padding{};
 }
 
-std::string TagFromTable(const sol::table& t) {
+static TextRange TagFromTable(const sol::table& t, RenderTree& tree) {
     const sol::optional<std::string> optionalTag = t["tag"];
-    return optionalTag ? *optionalTag : "";
+    return optionalTag ? tree.AddText(*optionalTag) : TextRange{};
+}
+
+// Colors used instead when the pointer is over a target with the tag of the node
+static void HoverStyleFromTable(const sol::table& t, Node& node) {
+    const sol::optional<sol::table> style = t["hover_style"];
+    node.hasHoverStyle = style.has_value();
+    if (!style) return;
+    const sol::optional<std::string> color = (*style)["color"];
+    const sol::optional<std::string> background = (*style)["background"];
+    node.hoverColor = color ? RGBA::FromString(*color) : node.color;
+    node.hoverBackground = background ? RGBA::FromString(*background) : node.background;
+    const sol::optional<sol::table> border = (*style)["border"];
+    node.hoverBorderColor = border ? RGBAFromProperty(*border, "color") : node.border.color;
+}
+
+// Properties of a node when placed in a flex container
+static void ItemFromTable(const sol::table& t, Node& node) {
+    node.grow = GetIntProperty(t, "grow", 0);
+    node.shrink = GetIntProperty(t, "shrink", 1);
+    node.minSize = Size{GetIntProperty(t, "min_width", 0), GetIntProperty(t, "min_height", 0)};
+    node.maxSize = Size{GetIntProperty(t, "max_width", 0), GetIntProperty(t, "max_height", 0)};
 }
 
-static std::unique_ptr<MarkupBox> MarkupBoxFromTable(const sol::table& t) {
+static FlexJustify JustifyFromTable(const sol::table& t) {
+    const sol::optional<std::string> justify = t["justify"];
+    if (!justify || *justify == "start") return FlexJustify::Start;
+    if (*justify == "end") return FlexJustify::End;
+    if (*justify == "center") return FlexJustify::Center;
+    if (*justify == "space_between") return FlexJustify::SpaceBetween;
+    if (*justify == "space_around") return FlexJustify::SpaceAround;
+    if (*justify == "space_evenly") return FlexJustify::SpaceEvenly;
+    spdlog::warn("Unknown justify: {}", *justify);
+    return FlexJustify::Start;
+}
+
+static FlexAlign AlignFromTable(const sol::table& t) {
+    const sol::optional<std::string> align = t["align"];
+    if (!align || *align == "start") return FlexAlign::Start;
+    if (*align == "end") return FlexAlign::End;
+    if (*align == "center") return FlexAlign::Center;
+    if (*align == "stretch") return FlexAlign::Stretch;
+    spdlog::warn("Unknown align: {}", *align);
+    return FlexAlign::Start;
+}
+
+static bool MarkupBoxFromTable(const sol::table& t, RenderTree& tree, uint32_t index) {
     const sol::optional<std::string> optionalMarkup = t["markup"];
-    const std::string markup = optionalMarkup ? *optionalMarkup : "";
-    auto box = std::make_unique<MarkupBox>(markup);
-    box->radius = GetIntProperty(t, "radius", 0);
-    box->border = BorderFromProperty(t, "border");
-    box->color = RGBAFromProperty(t, "color");
-    box->padding = PaddingFromProperty(t, "padding");
-    box->tag = TagFromTable(t);
-    return box;
-}
-
-static std::unique_ptr<Renderable> FromObject(const sol::object& o);
-static void FromChildTable(const sol::table childTable,
-                           std::vector<std::unique_ptr<Renderable>>& children) {
+    const auto markup = optionalMarkup ? tree.AddText(*optionalMarkup) : TextRange{};
+    const auto tag = TagFromTable(t, tree);
+    auto& box = tree.At(index);
+    box.type = NodeType::Box;
+    box.markup = markup;
+    box.radius = GetIntProperty(t, "radius", 0);
+    box.border = BorderFromProperty(t, "border");
+    box.color = RGBAFromProperty(t, "color");
+    box.padding = PaddingFromProperty(t, "padding");
+    box.tag = tag;
+    HoverStyleFromTable(t, box);
+    ItemFromTable(t, box);
+    return true;
+}
+
+static bool ImageFromTable(const sol::table& t, RenderTree& tree, uint32_t index) {
+    const sol::optional<std::string> path = t["path"];
+    if (!path) {
+        spdlog::error("Image without path");
+        return false;
+    }
+    const auto pathText = tree.AddText(*path);
+    const auto tag = TagFromTable(t, tree);
+    auto& image = tree.At(index);
+    image.type = NodeType::Image;
+    image.path = pathText;
+    image.size = Size{GetIntProperty(t, "width", 0), GetIntProperty(t, "height", 0)};
+    image.tag = tag;
+    ItemFromTable(t, image);
+    return true;
+}
+
+// Recent values of published numbers, keyed by source and field like "audio.volume"
+using Histories = std::map<std::string, History, std::less<>>;
+
+static ValueRange ValuesFromTable(const sol::table& t, RenderTree& tree,
+                                  const Histories& histories) {
+    std::vector<float> values;
+    const sol::optional<std::string> history = t["history"];
+    if (history) {
+        auto it = histories.find(*history);
+        if (it == histories.end()) {
+            spdlog::warn("No history named {}", *history);
+            return ValueRange{};
+        }
+        it->second.Values(values);
+        return tree.AddValues(values);
+    }
+    const sol::optional<sol::table> table = t["values"];
+    if (table) {
+        for (size_t i = 0; i < table->size(); i++) {
+            values.push_back((*table)[i + 1].get_or(0.0f));
+        }
+    }
+    return tree.AddValues(values);
+}
+
+// Bars, gauges and sparklines
+static bool MeterFromTable(const sol::table& t, RenderTree& tree, uint32_t index, NodeType type,
+                           const Histories& histories) {
+    const auto values =
+        type == NodeType::Sparkline ? ValuesFromTable(t, tree, histories) : ValueRange{};
+    const auto tag = TagFromTable(t, tree);
+    const auto size = type == NodeType::Bar     ? Size{60, 8}
+                      : type == NodeType::Gauge ? Size{24, 24}
+                                                : Size{60, 20};
+    auto& meter = tree.At(index);
+    meter.type = type;
+    meter.size = Size{GetIntProperty(t, "width", size.cx), GetIntProperty(t, "height", size.cy)};
+    meter.value = t.get_or("value", 0.0f);
+    meter.values = values;
+    meter.minValue = t.get_or("min", 0.0f);
+    meter.maxValue = t.get_or("max", 100.0f);
+    meter.lineWidth = GetIntProperty(t, "line_width", type == NodeType::Gauge ? 3 : 1);
+    meter.color = RGBAFromProperty(t, "color");
+    meter.background = RGBAFromProperty(t, "background");
+    meter.radius = GetIntProperty(t, "radius", 0);
+    const sol::optional<std::string> direction = t["direction"];
+    meter.isColumn = direction && *direction == "column";
+    meter.tag = tag;
+    HoverStyleFromTable(t, meter);
+    ItemFromTable(t, meter);
+    return true;
+}
+
+static bool FromObject(const sol::object& o, RenderTree& tree, uint32_t index,
+                       const Histories& histories);
+static void FromChildTable(const sol::table childTable, RenderTree& tree, uint32_t parent,
+                           const Histories& histories) {
+    // Children are stored next to each other, reserve them all before filling them in since
+    // grand children are added after.
     size_t size = childTable.size();
+    const auto first = tree.AddChildren(parent, size);
     for (size_t i = 0; i < size; i++) {
         const sol::object& o = childTable[i + 1];
-        auto b = FromObject(o);
-        if (b) {
-            children.push_back(std::move(b));
+        if (!FromObject(o, tree, first + i, histories)) {
+            // Takes no space, same as leaving it out
+            tree.At(first + i).type = NodeType::Empty;
         }
     }
 }
 
-static std::unique_ptr<Renderable> FlexContainerFromTable(const sol::table& t) {
-    FlexContainer f;
+static bool FlexContainerFromTable(const sol::table& t, RenderTree& tree, uint32_t index,
+                                   const Histories& histories) {
     const sol::optional<std::string> direction = t["direction"];
-    f.isColumn = direction ? *direction == "column" : true;
+    const bool isColumn = direction ? *direction == "column" : true;
     // TODO: Log, report
-    if (!f.isColumn && *direction != "row") return nullptr;
+    if (!isColumn && *direction != "row") return false;
+    const auto tag = TagFromTable(t, tree);
+    auto& f = tree.At(index);
+    f.type = NodeType::Flex;
+    f.isColumn = isColumn;
     f.padding = PaddingFromProperty(t, "padding");
+    f.tag = tag;
+    f.justify = JustifyFromTable(t);
+    f.align = AlignFromTable(t);
+    f.gap = GetIntProperty(t, "gap", 0);
+    f.wrap = t.get_or("wrap", false);
+    ItemFromTable(t, f);
     sol::optional<sol::table> children = t["items"];
     if (children) {
-        FromChildTable(*children, f.children);
+        FromChildTable(*children, tree, index, histories);
     }
-    f.tag = TagFromTable(t);
-    return std::unique_ptr<Renderable>(new FlexContainer(std::move(f)));
+    return true;
 }
 
-static std::unique_ptr<Renderable> FromObject(const sol::object& o) {
+static bool FromObject(const sol::object& o, RenderTree& tree, uint32_t index,
+                       const Histories& histories) {
     if (o.is<std::string>()) {
-        return std::make_unique<Markup>(o.as<std::string>());
+        const auto markup = tree.AddText(o.as<std::string>());
+        auto& node = tree.At(index);
+        node.type = NodeType::Markup;
+        node.markup = markup;
+        return true;
     }
     if (!o.is<sol::table>()) {
-        return nullptr;
+        return false;
     }
     const auto& t = o.as<sol::table>();
     const sol::optional<std::string> type = t["type"];
     if (!type) {
-        return nullptr;
+        return false;
     }
     if (*type == "flex") {
-        return FlexContainerFromTable(t);
+        return FlexContainerFromTable(t, tree, index, histories);
     }
     if (*type == "box") {
-        return MarkupBoxFromTable(t);
+        return MarkupBoxFromTable(t, tree, index);
+    }
+    if (*type == "image") {
+        return ImageFromTable(t, tree, index);
+    }
+    if (*type == "bar") {
+        return MeterFromTable(t, tree, index, NodeType::Bar, histories);
     }
-    return nullptr;
+    if (*type == "gauge") {
+        return MeterFromTable(t, tree, index, NodeType::Gauge, histories);
+    }
+    if (*type == "sparkline") {
+        return MeterFromTable(t, tree, index, NodeType::Sparkline, histories);
+    }
+    return false;
 }
 
 static std::set<std::string> ParseSources(const sol::table& widgetTable) {
@@ -115,7 +267,21 @@ static std::set<std::string> ParseSources(const sol::table& widgetTable) {
     return sources;
 }
 
-static void ParseWidgetConfig(const sol::table& table, std::vector<WidgetConfig>& widgets) {
+static std::vector<std::string> ParseFonts(const sol::table& root) {
+    std::vector<std::string> fonts;
+    const sol::optional<sol::table> table = root["fonts"];
+    if (!table) {
+        return fonts;
+    }
+    auto numFonts = table->size();
+    for (size_t i = 0; i < numFonts; i++) {
+        fonts.push_back(table->get<std::string>(i + 1));
+    }
+    return fonts;
+}
+
+static void ParseWidgetConfig(const sol::table& table, std::vector<WidgetConfig>& widgets,
+                              const Histories& histories) {
     WidgetConfig widget;
     widget.sources = ParseSources(table);
     sol::optional<sol::protected_function> maybeRenderFunction = table["on_render"];
@@ -124,13 +290,14 @@ static void ParseWidgetConfig(const sol::table& table, std::vector<WidgetConfig>
         return;
     }
     auto renderFunction = *maybeRenderFunction;
-    widget.render = [renderFunction](auto outputName) {
+    widget.render = [renderFunction, &histories](const std::string& outputName,
+                                                 RenderTree& tree) {
         sol::optional<sol::object> result = renderFunction(outputName);
         if (!result) {
             spdlog::error("Bad return from render function");
-            return std::unique_ptr<Renderable>(nullptr);
+            return false;
         }
-        return FromObject(*result);
+        return FromObject(*result, tree, tree.Add(NodeType::Empty), histories);
     };
     // Click handler
     sol::optional<sol::protected_function> maybeClickFunction = table["on_click"];
@@ -150,11 +317,18 @@ static void ParseWidgetConfig(const sol::table& table, std::vector<WidgetConfig>
             return true;
         };
     }
+    // Hover handler
+    sol::optional<sol::protected_function> maybeHoverFunction = table["on_hover"];
+    if (maybeHoverFunction) {
+        auto hoverFunction = *maybeHoverFunction;
+        widget.hover = [hoverFunction](std::string_view tag) { hoverFunction(tag); };
+    }
     widget.padding = PaddingFromProperty(table, "padding");
     widgets.push_back(std::move(widget));
 }
 
-static PanelConfig ParsePanelConfig(const sol::table panelTable, int index) {
+static PanelConfig ParsePanelConfig(const sol::table panelTable, int index,
+                                    const Histories& histories) {
     auto panel = PanelConfig{};
     if (!panelTable) {
         return panel;
@@ -186,6 +360,7 @@ static PanelConfig ParsePanelConfig(const sol::table panelTable, int index) {
     }
     const sol::optional<std::string> directionString = panelTable["direction"];
     panel.isColumn = !directionString || *directionString != "row";
+    panel.subsurfaces = panelTable.get_or("subsurfaces", false);
 
     sol::optional<sol::protected_function> optionalCheckDisplay = panelTable["on_display"];
     if (optionalCheckDisplay) {
@@ -215,7 +390,7 @@ static PanelConfig ParsePanelConfig(const sol::table panelTable, int index) {
             // TODO: Log!
             continue;
         }
-        ParseWidgetConfig(*widgetTable, panel.widgets);
+        ParseWidgetConfig(*widgetTable, panel.widgets, histories);
     }
     return panel;
 }
@@ -229,9 +404,13 @@ class ScriptContextImpl : public ScriptContext {
     void Publish(const std::string_view name, const AudioState& audio) override;
     void Publish(const std::string_view name, const KeyboardState& keyboard) override;
     void Publish(const std::string_view name, const Networks& networks) override;
+    void SampleHistories() override;
 
    private:
+    void Record(std::string_view name, std::string_view field, float value);
+
     sol::state m_lua;
+    Histories m_histories;
 };
 
 static DisplaysConfig ParseDisplays(sol::optional<sol::table> sourcesTable) {
@@ -266,7 +445,8 @@ static AudioConfig ParseAudio(sol::optional<sol::table> sourcesTable) {
     return config;
 }
 
-static std::shared_ptr<Configuration> ParseConfig(sol::optional<sol::table> root) {
+static std::shared_ptr<Configuration> ParseConfig(sol::optional<sol::table> root,
+                                                  const Histories& histories) {
     if (!root) return nullptr;
     // "Parse" the configuration state
     sol::optional<sol::table> panelsTable = (*root)["panels"];
@@ -282,42 +462,52 @@ static std::shared_ptr<Configuration> ParseConfig(sol::optional<sol::table> root
             spdlog::error("Expected panel table");
             continue;
         }
-        auto panel = ParsePanelConfig(*panelTable, i);
+        auto panel = ParsePanelConfig(*panelTable, i, histories);
         config->panels.push_back(panel);
     }
     // Alert panel. Reserve index -1 for alert
     std::optional<sol::table> alertPanelTable = (*root)["alert"];
     if (alertPanelTable) {
-        config->alertPanel = ParsePanelConfig(*alertPanelTable, -1);
+        config->alertPanel = ParsePanelConfig(*alertPanelTable, -1, histories);
     } else {
         config->alertPanel = PanelConfig{.widgets = {},
                                          .index = -1,
                                          .anchor = Anchor::Center,
                                          .isColumn = false,
-                                         .checkDisplay = nullptr};
-    }
-
-    // Buffers
-    sol::optional<sol::table> buffersTable = (*root)["buffers"];
-    config->numBuffers = 1;
-    config->bufferWidth = 1000;
-    config->bufferHeight = 1000;
-    if (buffersTable) {
-        config->numBuffers = GetIntProperty(*buffersTable, "num", config->numBuffers);
-        config->bufferWidth = GetIntProperty(*buffersTable, "width", config->bufferWidth);
-        config->bufferHeight = GetIntProperty(*buffersTable, "height", config->bufferHeight);
+                                         .checkDisplay = nullptr,
+                                         .subsurfaces = false};
     }
     // Sources
     auto sources = root->get<sol::optional<sol::table>>("sources");
     config->displays = ParseDisplays(sources);
     config->audio = ParseAudio(sources);
+    config->prerender = root->get_or("prerender", false);
+    config->atlas = root->get_or("atlas", false);
+    config->fonts = ParseFonts(*root);
     return config;
 }
 
+void ScriptContextImpl::Record(std::string_view name, std::string_view field, float value) {
+    // Two minutes when sampled every second
+    constexpr size_t historySamples = 120;
+    auto key = std::string(name) + "." + std::string(field);
+    auto it = m_histories.find(key);
+    if (it == m_histories.end()) {
+        it = m_histories.emplace(std::move(key), History(historySamples)).first;
+    }
+    it->second.Set(value);
+}
+
+void ScriptContextImpl::SampleHistories() {
+    for (auto& history : m_histories) {
+        history.second.Sample();
+    }
+}
+
 std::shared_ptr<Configuration> ScriptContextImpl::Execute(const char* path) {
     try {
         sol::optional<sol::table> configTable = m_lua.script_file(path);
-        return ParseConfig(configTable);
+        return ParseConfig(configTable, m_histories);
     } catch (const sol::error& e) {
         spdlog::error("Failed to  execute configuration file: {}", e.what());
         return nullptr;
@@ -362,6 +552,7 @@ void ScriptContextImpl::Publish(const std::string_view name, const PowerState& p
     table["isPluggedIn"] = power.IsPluggedIn;
     table["capacity"] = (int)power.Capacity;
     m_lua["zen"][name] = table;
+    Record(name, "capacity", power.Capacity);
 }
 
 void ScriptContextImpl::Publish(const std::string_view name, const AudioState& audio) {
@@ -370,6 +561,7 @@ void ScriptContextImpl::Publish(const std::string_view name, const AudioState& a
     table["volume"] = audio.Volume;
     table["port"] = audio.PortType;
     m_lua["zen"][name] = table;
+    Record(name, "volume", audio.Volume);
 }
 
 void ScriptContextImpl::Publish(const std::string_view name, const KeyboardState& keyboard) {
@@ -83,4 +83,6 @@ class ScriptContext {
     virtual void Publish(const std::string_view name, const AudioState& audio) = 0;
     virtual void Publish(const std::string_view name, const KeyboardState& keyboard) = 0;
     virtual void Publish(const std::string_view name, const Networks& networks) = 0;
+    // Samples the last published value of every number that has a history
+    virtual void SampleHistories() = 0;
 };
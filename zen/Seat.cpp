@@ -71,6 +71,19 @@ std::unique_ptr<Pointer> Pointer::Create(wl_seat* seat) {
     return pointer;
 }
 
+void Pointer::Leave() {
+    m_current = nullptr;
+    if (m_hoverHandler) m_hoverHandler(nullptr, 0, 0);
+}
+
+void Pointer::Track(wl_fixed_t x, wl_fixed_t y) {
+    m_x = x;
+    m_y = y;
+    if (!m_current) return;
+    if (!m_hoverHandler) return;
+    m_hoverHandler(m_current, wl_fixed_to_int(m_x), wl_fixed_to_int(m_y));
+}
+
 void Pointer::Click() {
     if (!m_current) return;
     if (!m_clickHandler) return;
@@ -11,6 +11,8 @@
 
 using ClickHandler = std::function<void(wl_surface*, int, int)>;
 using WheelHandler = std::function<void(wl_surface*, int, int, int)>;
+// Surface is null when the pointer left
+using HoverHandler = std::function<void(wl_surface*, int, int)>;
 
 class Keyboard : public Source {
    public:
@@ -38,16 +40,15 @@ class Pointer {
         wl_pointer_destroy(m_wlpointer);
         m_wlpointer = nullptr;
     }
-    void RegisterHandlers(ClickHandler clickHandler, WheelHandler wheelHandler) {
+    void RegisterHandlers(ClickHandler clickHandler, WheelHandler wheelHandler,
+                          HoverHandler hoverHandler) {
         m_clickHandler = clickHandler;
         m_wheelHandler = wheelHandler;
+        m_hoverHandler = hoverHandler;
     }
     void Enter(wl_surface* surface) { m_current = surface; }
-    void Leave() { m_current = nullptr; }
-    void Track(wl_fixed_t x, wl_fixed_t y) {
-        m_x = x;
-        m_y = y;
-    }
+    void Leave();
+    void Track(wl_fixed_t x, wl_fixed_t y);
     void Click();
     void Wheel(int value);
 
@@ -58,6 +59,7 @@ class Pointer {
     wl_fixed_t m_y;
     ClickHandler m_clickHandler;
     WheelHandler m_wheelHandler;
+    HoverHandler m_hoverHandler;
 };
 
 class Seat {
@@ -69,11 +71,12 @@ class Seat {
         m_wlseat = nullptr;
     }
 
-    void RegisterHandlers(ClickHandler clickHandler, WheelHandler wheelHandler) {
+    void RegisterHandlers(ClickHandler clickHandler, WheelHandler wheelHandler,
+                          HoverHandler hoverHandler) {
         // TODO: Log error
         if (!m_pointer) return;
 
-        m_pointer->RegisterHandlers(clickHandler, wheelHandler);
+        m_pointer->RegisterHandlers(clickHandler, wheelHandler, hoverHandler);
     }
 
     std::shared_ptr<Keyboard> keyboard;
@@ -3,14 +3,17 @@
 #include <spdlog/spdlog.h>
 #include <wayland-client-protocol.h>
 
+#include <algorithm>
+
 #include "wlr-layer-shell-unstable-v1.h"
 #include "zen/Registry.h"
 
 static void on_configure(void *data, struct zwlr_layer_surface_v1 *layer, uint32_t serial,
                          uint32_t cx, uint32_t cy) {
     auto shellSurface = (ShellSurface *)data;
-    shellSurface->OnShellConfigure(cx, cy);
+    // Ack before handling since the handler might commit
     zwlr_layer_surface_v1_ack_configure(layer, serial);
+    shellSurface->OnShellConfigure(cx, cy);
 }
 
 static void on_closed(void *data, struct zwlr_layer_surface_v1 *) {
@@ -21,17 +24,58 @@ static void on_closed(void *data, struct zwlr_layer_surface_v1 *) {
 static const zwlr_layer_surface_v1_listener layer_listener = {.configure = on_configure,
                                                               .closed = on_closed};
 
+static void on_frame_done(void *data, struct wl_callback *, uint32_t /*time*/) {
+    auto shellSurface = (ShellSurface *)data;
+    shellSurface->OnFrameDone();
+}
+
+static const wl_callback_listener frame_listener = {.done = on_frame_done};
+
 std::unique_ptr<ShellSurface> ShellSurface::Create(const Registry &registry, wl_output *output,
                                                    PanelConfig panelConfig) {
     auto surface = wl_compositor_create_surface(registry.compositor);
-    auto shellSurface =
-        std::unique_ptr<ShellSurface>(new ShellSurface(output, surface, std::move(panelConfig)));
+    // Double buffered, buffers are sized to what is drawn. Grows to triple buffering when the
+    // compositor holds on to buffers.
+    auto bufferPool = BufferPool::Create(*registry.shm, 2, 3);
+    auto shellSurface = std::unique_ptr<ShellSurface>(
+        new ShellSurface(output, surface, std::move(bufferPool), std::move(panelConfig)));
+    if (shellSurface->m_panelConfig.subsurfaces && !registry.subcompositor) {
+        spdlog::warn("No subcompositor, drawing all widgets in the panel surface");
+    } else if (shellSurface->m_panelConfig.subsurfaces) {
+        for (size_t i = 0; i < shellSurface->m_panelConfig.widgets.size(); i++) {
+            auto widgetSurface = wl_compositor_create_surface(registry.compositor);
+            auto subsurface =
+                wl_subcompositor_get_subsurface(registry.subcompositor, widgetSurface, surface);
+            // Widgets are committed on their own without committing the panel
+            wl_subsurface_set_desync(subsurface);
+            shellSurface->m_widgetSurfaces.push_back(
+                WidgetSurface{.surface = widgetSurface,
+                              .subsurface = subsurface,
+                              .bufferPool = BufferPool::Create(*registry.shm, 2, 3),
+                              .drawn = {},
+                              .frame = 0,
+                              .x = 0,
+                              .y = 0,
+                              .committedX = 0,
+                              .committedY = 0,
+                              .needsCommit = false,
+                              .pendingBuffer = nullptr});
+        }
+    }
     wl_surface_commit(surface);
     return shellSurface;
 }
 
 void ShellSurface::OnShellConfigure(uint32_t cx, uint32_t cy) {
     spdlog::trace("Event zwlr_layer_surface::configure size {}x{}", cx, cy);
+    if (m_isConfigured) {
+        return;
+    }
+    m_isConfigured = true;
+    // Buffer could not be attached before initial configure
+    if (m_pendingBuffer) {
+        Commit();
+    }
 };
 
 void ShellSurface::OnClosed() {
@@ -39,146 +83,525 @@ void ShellSurface::OnClosed() {
     m_isClosed = true;
 }
 
+void ShellSurface::OnFrameDone() {
+    spdlog::trace("Event wl_callback::done for frame, deferred draw: {}", m_needsDraw);
+    wl_callback_destroy(m_frameCallback);
+    m_frameCallback = nullptr;
+}
+
+bool ShellSurface::FindTarget(wl_surface *surface, int x, int y, size_t &widget,
+                              std::string &tag) {
+    if (!ToPanelCoordinates(surface, x, y)) {
+        return false;
+    }
+    if (m_isHitGridStale) {
+        m_hitGrid.Build(m_drawn);
+        m_isHitGridStale = false;
+    }
+    int target;
+    widget = none;
+    tag.clear();
+    if (m_hitGrid.Find(x, y, widget, target) && target >= 0) {
+        // Widget might have inner more specific targets
+        tag = m_drawn.widgets[widget].targets[target].tag;
+    }
+    return true;
+}
+
 bool ShellSurface::ClickSurface(wl_surface *surface, int x, int y) {
-    if (surface != m_surface) {
+    size_t widget;
+    std::string tag;
+    if (!FindTarget(surface, x, y, widget, tag)) {
         return false;
     }
-    // Check what widget
-    int i = 0;
-    for (const auto &w : m_drawn.widgets) {
-        if (w.position.Contains(x, y)) {
-            auto &widget = m_panelConfig.widgets.at(i);
-            if (widget.click) {
-                // Widget has a click handler. There might be inner more
-                // specific targets, find the tag of the correct one.
-                std::string tag = "";
-                for (const auto &t : w.targets) {
-                    if (t.position.Contains(x, y)) {
-                        tag = t.tag;
-                        break;
-                    }
-                }
-                spdlog::debug("Click in widget, tag: {}", tag);
-                widget.click(tag);
-            }
-            break;
-        }
-        i++;
+    if (widget != none && m_panelConfig.widgets.at(widget).click) {
+        spdlog::debug("Click in widget, tag: {}", tag);
+        m_panelConfig.widgets.at(widget).click(tag);
     }
     // Return true even if no widget was found to stop trying other surfaces
     return true;
 }
 
-// TODO: Refactor to share some code between Click and Wheel
 bool ShellSurface::WheelSurface(wl_surface *surface, int x, int y, int value) {
-    if (surface != m_surface) {
+    size_t widget;
+    std::string tag;
+    if (!FindTarget(surface, x, y, widget, tag)) {
         return false;
     }
-    // Check what widget
-    int i = 0;
-    for (const auto &w : m_drawn.widgets) {
-        if (w.position.Contains(x, y)) {
-            auto &widget = m_panelConfig.widgets.at(i);
-            if (widget.wheel) {
-                // Widget has a wheel handler. There might be inner more
-                // specific targets, find the tag of the correct one.
-                std::string tag = "";
-                for (const auto &t : w.targets) {
-                    if (t.position.Contains(x, y)) {
-                        tag = t.tag;
-                        break;
-                    }
-                }
-                spdlog::debug("Wheel in widget, tag: {}", tag);
-                widget.wheel(tag, value);
-            }
-            break;
-        }
-        i++;
+    if (widget != none && m_panelConfig.widgets.at(widget).wheel) {
+        spdlog::debug("Wheel in widget, tag: {}", tag);
+        m_panelConfig.widgets.at(widget).wheel(tag, value);
     }
     // Return true even if no widget was found to stop trying other surfaces
     return true;
 }
 
-void ShellSurface::Draw(const Registry &registry, BufferPool &bufferPool,
-                        const std::string &outputName) {
-    if (m_isClosed) {
-        return;
+bool ShellSurface::HoverSurface(wl_surface *surface, int x, int y) {
+    size_t widget = none;
+    std::string tag;
+    const bool isInSurface = surface && FindTarget(surface, x, y, widget, tag);
+    if (widget == m_hoveredWidget && tag == m_hoveredTag) {
+        return isInSurface;
     }
-    m_drawn.widgets.clear();
-    if (!Draw::Panel(m_panelConfig, outputName, bufferPool, m_drawn)) {
-        // Nothing drawn for this output
-        return;
+    const uint64_t frame = m_frame + 1;
+    bool needsDraw = false;
+    if (m_hoveredWidget != none && m_hoveredWidget != widget) {
+        // Left the previous widget
+        if (m_hoveredWidget < m_widgets.size()) {
+            needsDraw = m_widgets[m_hoveredWidget].SetHover("", frame);
+        }
+        const auto &hover = m_panelConfig.widgets.at(m_hoveredWidget).hover;
+        if (hover) hover("");
     }
-    if (!m_layer) {
-        m_layer = zwlr_layer_shell_v1_get_layer_surface(
-            registry.shell, m_surface, m_output, ZWLR_LAYER_SHELL_V1_LAYER_OVERLAY, "namespace");
-        zwlr_layer_surface_v1_add_listener(m_layer, &layer_listener, this);
-        zwlr_layer_surface_v1_set_size(m_layer, 1, 1);
-        zwlr_layer_surface_v1_set_anchor(m_layer, ZWLR_LAYER_SURFACE_V1_ANCHOR_LEFT);
-        wl_surface_commit(m_surface);
-        registry.FlushAndDispatchCommands();
+    if (widget != none) {
+        if (widget < m_widgets.size()) {
+            needsDraw = m_widgets[widget].SetHover(tag, frame) || needsDraw;
+        }
+        const auto &hover = m_panelConfig.widgets.at(widget).hover;
+        if (hover) hover(tag);
     }
-    const auto &size = m_drawn.size;
-    Size damage;
-    damage.cx = std::max(size.cx, m_previousDamage.cx);
-    damage.cy = std::max(size.cy, m_previousDamage.cy);
-    spdlog::trace("Draw buffer: {}x{}, damaging {}x{}", size.cx, size.cy, damage.cx, damage.cy);
-    zwlr_layer_surface_v1_set_size(m_layer, size.cx, size.cy);
-    auto anchor = m_panelConfig.anchor;
-    uint32_t zanchor = ZWLR_LAYER_SURFACE_V1_ANCHOR_LEFT;
+    spdlog::debug("Hover in widget {}, tag: {}", widget != none ? (int)widget : -1, tag);
+    m_hoveredWidget = widget;
+    m_hoveredTag = tag;
+    // Drawn when the compositor is ready for a new frame
+    if (needsDraw && !m_isHidden) {
+        m_needsDraw = true;
+    }
+    return isInSurface;
+}
+
+bool ShellSurface::ToPanelCoordinates(wl_surface *surface, int &x, int &y) const {
+    if (surface == m_surface) {
+        return true;
+    }
+    for (const auto &widgetSurface : m_widgetSurfaces) {
+        if (widgetSurface.surface == surface) {
+            x += widgetSurface.committedX;
+            y += widgetSurface.committedY;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool ShellSurface::IsExhausted() const {
+    const auto &bufferPool = m_atlasPool ? *m_atlasPool : *m_bufferPool;
+    return bufferPool.IsExhausted() ||
+           std::any_of(m_widgetSurfaces.begin(), m_widgetSurfaces.end(),
+                       [](const auto &widgetSurface) {
+                           return widgetSurface.bufferPool->IsExhausted();
+                       });
+}
+
+static uint32_t ToLayerAnchor(Anchor anchor) {
     switch (anchor) {
         case Anchor::Left:
-            zanchor = ZWLR_LAYER_SURFACE_V1_ANCHOR_LEFT;
-            break;
+            return ZWLR_LAYER_SURFACE_V1_ANCHOR_LEFT;
         case Anchor::Right:
-            zanchor = ZWLR_LAYER_SURFACE_V1_ANCHOR_RIGHT;
-            break;
+            return ZWLR_LAYER_SURFACE_V1_ANCHOR_RIGHT;
         case Anchor::Top:
-            zanchor = ZWLR_LAYER_SURFACE_V1_ANCHOR_TOP;
-            break;
+            return ZWLR_LAYER_SURFACE_V1_ANCHOR_TOP;
         case Anchor::Bottom:
-            zanchor = ZWLR_LAYER_SURFACE_V1_ANCHOR_BOTTOM;
-            break;
+            return ZWLR_LAYER_SURFACE_V1_ANCHOR_BOTTOM;
         case Anchor::TopLeft:
-            zanchor = ZWLR_LAYER_SURFACE_V1_ANCHOR_LEFT | ZWLR_LAYER_SURFACE_V1_ANCHOR_TOP;
-            break;
+            return ZWLR_LAYER_SURFACE_V1_ANCHOR_LEFT | ZWLR_LAYER_SURFACE_V1_ANCHOR_TOP;
         case Anchor::TopRight:
-            zanchor = ZWLR_LAYER_SURFACE_V1_ANCHOR_RIGHT | ZWLR_LAYER_SURFACE_V1_ANCHOR_TOP;
-            break;
+            return ZWLR_LAYER_SURFACE_V1_ANCHOR_RIGHT | ZWLR_LAYER_SURFACE_V1_ANCHOR_TOP;
         case Anchor::BottomLeft:
-            zanchor = ZWLR_LAYER_SURFACE_V1_ANCHOR_LEFT | ZWLR_LAYER_SURFACE_V1_ANCHOR_BOTTOM;
-            break;
+            return ZWLR_LAYER_SURFACE_V1_ANCHOR_LEFT | ZWLR_LAYER_SURFACE_V1_ANCHOR_BOTTOM;
         case Anchor::BottomRight:
-            zanchor = ZWLR_LAYER_SURFACE_V1_ANCHOR_RIGHT | ZWLR_LAYER_SURFACE_V1_ANCHOR_BOTTOM;
-            break;
+            return ZWLR_LAYER_SURFACE_V1_ANCHOR_RIGHT | ZWLR_LAYER_SURFACE_V1_ANCHOR_BOTTOM;
         case Anchor::Center:
-            zanchor = ZWLR_LAYER_SURFACE_V1_ANCHOR_LEFT | ZWLR_LAYER_SURFACE_V1_ANCHOR_RIGHT |
-                      ZWLR_LAYER_SURFACE_V1_ANCHOR_TOP | ZWLR_LAYER_SURFACE_V1_ANCHOR_BOTTOM;
-            break;
-    }
-    zwlr_layer_surface_v1_set_anchor(m_layer, zanchor);
-    wl_surface_attach(m_surface, m_drawn.buffer->Lock(), 0, 0);
-    wl_surface_damage_buffer(m_surface, 0, 0, damage.cx, damage.cy);
-    // Maintain input region
-    if (m_inputRegion) {
-        wl_region_destroy(m_inputRegion);
-    }
-    m_inputRegion = wl_compositor_create_region(registry.compositor);
-    wl_region_add(m_inputRegion, 0, 0, size.cx, size.cy);
-    wl_surface_set_input_region(m_surface, m_inputRegion);
+            return ZWLR_LAYER_SURFACE_V1_ANCHOR_LEFT | ZWLR_LAYER_SURFACE_V1_ANCHOR_RIGHT |
+                   ZWLR_LAYER_SURFACE_V1_ANCHOR_TOP | ZWLR_LAYER_SURFACE_V1_ANCHOR_BOTTOM;
+    }
+    return ZWLR_LAYER_SURFACE_V1_ANCHOR_LEFT;
+}
+
+bool ShellSurface::Render(const std::string &outputName, const std::vector<bool> &dirtyWidgets) {
+    if (m_isClosed) {
+        return false;
+    }
+    // Dirty widgets changes in next frame, also when the draw is deferred
+    for (size_t i = 0; i < m_changedAt.size() && i < dirtyWidgets.size(); i++) {
+        if (dirtyWidgets[i]) {
+            m_changedAt[i] = m_frame + 1;
+        }
+    }
+    m_needsDraw = true;
+    if (!IsReadyForFrame()) {
+        spdlog::trace("Frame in flight or waiting for configure, deferring draw");
+        return false;
+    }
+    if (IsExhausted()) {
+        // Retried when the compositor releases a buffer
+        m_bufferPool->OnDeferred();
+        LogBufferStats("All buffers busy, deferring draw");
+        return false;
+    }
+    // A frame that has been rasterized but not submitted can be submitted as is when nothing
+    // changed since.
+    m_needsRaster = !m_isRasterized ||
+                    std::any_of(m_changedAt.begin(), m_changedAt.end(),
+                                [this](auto frame) { return frame > m_frame; }) ||
+                    std::any_of(m_widgets.begin(), m_widgets.end(), [this](const auto &widget) {
+                        return widget.HoveredAt() > m_frame;
+                    });
+    if (m_needsRaster) {
+        Draw::Render(m_panelConfig, outputName, m_frame + 1, m_changedAt, m_widgets);
+    }
+    return true;
+}
+
+void ShellSurface::Raster() {
+    if (!m_needsRaster) {
+        return;
+    }
+    if (!m_widgetSurfaces.empty()) {
+        m_isRasterized = RasterSubsurfaces();
+    } else {
+        m_isRasterized = Draw::Panel(m_panelConfig, *m_bufferPool, m_frame + 1, m_changedAt,
+                                     m_widgets, m_drawn);
+    }
+    if (m_isRasterized) {
+        m_frame++;
+        m_isHitGridStale = true;
+    }
+}
+
+bool ShellSurface::RasterSubsurfaces() {
+    thread_local std::vector<Rect> rects;
+    const auto size = Draw::Layout(m_panelConfig, m_widgets, rects);
+    const uint64_t frame = m_frame + 1;
+    // Panel surface is transparent, it only needs a new buffer when resized or purged
+    if (!m_drawn.buffer || m_drawn.buffer->Frame() == 0 || m_drawn.size.cx != size.cx ||
+        m_drawn.size.cy != size.cy) {
+        auto buffer = m_bufferPool->Get(size.cx, size.cy);
+        if (!buffer) {
+            return false;
+        }
+        buffer->Clear(0x00);
+        buffer->SetContent(frame, {});
+        m_drawn.damage = {Rect{0, 0, std::max(size.cx, m_drawn.size.cx),
+                               std::max(size.cy, m_drawn.size.cy)}};
+        m_drawn.buffer = buffer;
+        m_drawn.size = size;
+        m_isPanelChanged = true;
+    }
+    // Only widgets that changed are drawn, the others keep their buffer
+    m_drawn.widgets.resize(m_widgets.size());
+    for (size_t i = 0; i < m_widgetSurfaces.size(); i++) {
+        auto &widgetSurface = m_widgetSurfaces[i];
+        const auto &rect = rects[i];
+        auto &drawn = widgetSurface.drawn;
+        const bool isDrawn = drawn.buffer && drawn.buffer->Frame() == widgetSurface.frame &&
+                             drawn.size.cx == rect.cx && drawn.size.cy == rect.cy;
+        // Widgets where only hover changed are copied from their tile
+        if (m_changedAt[i] > m_frame || m_widgets[i].HoveredAt() > m_frame || !isDrawn) {
+            if (!Draw::SingleWidget(m_widgets[i], *widgetSurface.bufferPool, frame, drawn)) {
+                return false;
+            }
+            widgetSurface.frame = frame;
+            widgetSurface.needsCommit = true;
+        }
+        widgetSurface.x = rect.x;
+        widgetSurface.y = rect.y;
+        // Hit testing is done in panel coordinates
+        auto &drawnWidget = m_drawn.widgets[i];
+        drawnWidget.position = rect;
+        drawnWidget.targets = drawn.widgets[0].targets;
+        for (auto &target : drawnWidget.targets) {
+            target.position.x += rect.x;
+            target.position.y += rect.y;
+        }
+    }
+    return true;
+}
+
+void ShellSurface::UseAtlas(const Registry &registry, BufferPool *atlasPool) {
+    m_atlasPool = atlasPool;
+    m_viewport = wp_viewporter_get_viewport(registry.viewporter, m_surface);
+}
+
+Size ShellSurface::Layout() { return Draw::Layout(m_panelConfig, m_widgets, m_rects); }
+
+void ShellSurface::RasterAtlas(std::shared_ptr<Buffer> atlas, const Rect &region) {
+    if (!atlas) {
+        m_isRasterized = false;
+        return;
+    }
+    // Other panels are drawn in the same buffer, everything in the region is repainted. Widget
+    // tiles are kept so unchanged widgets are only copied.
+    const uint64_t frame = m_frame + 1;
+    const bool hasPrevious = m_drawn.widgets.size() == m_rects.size();
+    auto &damage = m_drawn.damage;
+    damage.clear();
+    atlas->ClearRect(region);
+    auto cr = atlas->GetCairoCtx();
+    m_drawn.widgets.resize(m_rects.size());
+    for (size_t i = 0; i < m_rects.size(); i++) {
+        const auto &rect = m_rects[i];
+        auto &drawnWidget = m_drawn.widgets[i];
+        // Damage what changed since previous frame
+        if (hasPrevious && (m_changedAt[i] == frame || drawnWidget.position != rect)) {
+            damage.push_back(drawnWidget.position);
+            damage.push_back(rect);
+        } else if (hasPrevious && m_widgets[i].HoveredAt() == frame) {
+            // Only targets that changed hover state
+            for (auto hoverDamage : m_widgets[i].HoverDamage()) {
+                hoverDamage.x += rect.x;
+                hoverDamage.y += rect.y;
+                damage.push_back(hoverDamage);
+            }
+        }
+        drawnWidget.position = rect;
+        drawnWidget.targets.clear();
+        // Widgets and their targets are in panel coordinates
+        cairo_save(cr);
+        cairo_translate(cr, region.x, region.y);
+        cairo_rectangle(cr, rect.x, rect.y, rect.cx, rect.cy);
+        cairo_clip(cr);
+        m_widgets[i].Draw(cr, rect.x, rect.y, drawnWidget.targets);
+        cairo_restore(cr);
+    }
+    if (!hasPrevious || m_drawn.size.cx != region.cx || m_drawn.size.cy != region.cy) {
+        damage.clear();
+        damage.push_back(Rect{0, 0, std::max(region.cx, m_drawn.size.cx),
+                              std::max(region.cy, m_drawn.size.cy)});
+    }
+    m_drawn.size = Size{region.cx, region.cy};
+    m_drawn.buffer = atlas;
+    m_atlasRect = region;
+    m_isRasterized = true;
+    m_frame++;
+    m_isHitGridStale = true;
+}
+
+size_t ShellSurface::RenderHash() const {
+    if (!m_widgetSurfaces.empty()) {
+        // Subsurfaces are committed per widget, they are never shared with other outputs
+        return (size_t)this;
+    }
+    size_t hash = m_panelConfig.index;
+    for (const auto &widget : m_widgets) {
+        hash ^= widget.TreeHash() + 0x9e3779b9 + (hash << 6) + (hash >> 2);
+    }
+    return hash;
+}
+
+void ShellSurface::Share(const ShellSurface &other) {
+    m_isRasterized = other.m_isRasterized;
+    if (!m_isRasterized) {
+        return;
+    }
+    m_frame++;
+    m_isHitGridStale = true;
+    // Never drawn this buffer, everything needs to be damaged
+    const auto &size = other.m_drawn.size;
+    m_drawn.damage = {
+        Rect{0, 0, std::max(size.cx, m_drawn.size.cx), std::max(size.cy, m_drawn.size.cy)}};
+    m_drawn.buffer = other.m_drawn.buffer;
+    m_drawn.size = size;
+    m_drawn.widgets = other.m_drawn.widgets;
+}
+
+// No roundtrips in here, commands are flushed by the caller when all surfaces are done.
+void ShellSurface::Submit(const Registry &registry) {
+    if (!m_isRasterized) {
+        // Nothing drawn for this output, do not retry until next change
+        m_needsDraw = false;
+        m_bufferPool->OnDropped();
+        LogBufferStats("Failed to draw, dropping draw");
+        return;
+    }
+    m_isRasterized = false;
+    m_needsDraw = false;
+    const auto &size = m_drawn.size;
+    // Layer surface is created once and kept for the lifetime of the surface
+    if (!m_layer) {
+        m_layer = zwlr_layer_shell_v1_get_layer_surface(
+            registry.shell, m_surface, m_output, ZWLR_LAYER_SHELL_V1_LAYER_OVERLAY, "namespace");
+        zwlr_layer_surface_v1_add_listener(m_layer, &layer_listener, this);
+        zwlr_layer_surface_v1_set_anchor(m_layer, ToLayerAnchor(m_panelConfig.anchor));
+        m_emptyRegion = wl_compositor_create_region(registry.compositor);
+        m_isConfigured = false;
+        m_isHidden = true;
+    }
+    const bool wasHidden = m_isHidden;
+    if (m_isHidden) {
+        // Surface shows a transparent pixel, everything needs to be damaged
+        m_drawn.damage = {Rect{0, 0, size.cx, size.cy}};
+        m_isHidden = false;
+        m_inputSize = Size{};
+        // Subsurfaces were unmapped when hidden
+        for (auto &widgetSurface : m_widgetSurfaces) {
+            widgetSurface.needsCommit = widgetSurface.drawn.buffer != nullptr;
+        }
+    }
+    // Lock them now to keep them from being reused while waiting for configure
+    if (m_widgetSurfaces.empty() || m_isPanelChanged || wasHidden) {
+        m_pendingBuffer = m_drawn.buffer->Lock();
+    }
+    m_isPanelChanged = false;
+    for (auto &widgetSurface : m_widgetSurfaces) {
+        if (widgetSurface.needsCommit) {
+            widgetSurface.pendingBuffer = widgetSurface.drawn.buffer->Lock();
+            widgetSurface.needsCommit = false;
+        }
+    }
+    if (size.cx != m_inputSize.cx || size.cy != m_inputSize.cy) {
+        zwlr_layer_surface_v1_set_size(m_layer, size.cx, size.cy);
+        // Regions can not be resized
+        if (m_inputRegion) {
+            wl_region_destroy(m_inputRegion);
+        }
+        m_inputRegion = wl_compositor_create_region(registry.compositor);
+        wl_region_add(m_inputRegion, 0, 0, size.cx, size.cy);
+        wl_surface_set_input_region(m_surface, m_inputRegion);
+        m_inputSize = size;
+    }
+    if (!m_isConfigured) {
+        // Initial commit without buffer, the buffer is committed when configured.
+        wl_surface_commit(m_surface);
+        return;
+    }
+    Commit();
+}
+
+void ShellSurface::LogBufferStats(const std::string_view message) const {
+    const auto &stats = m_bufferPool->GetStats();
+    spdlog::debug("{}, buffer stats: dropped {}, deferred {}, grown {}", message, stats.dropped,
+                  stats.deferred, stats.grown);
+}
+
+bool ShellSurface::CommitSubsurfaces(bool isPanelCommitted) {
+    // Positions are applied when the panel surface is committed
+    bool isMoved = false;
+    for (auto &widgetSurface : m_widgetSurfaces) {
+        if (widgetSurface.x != widgetSurface.committedX ||
+            widgetSurface.y != widgetSurface.committedY) {
+            wl_subsurface_set_position(widgetSurface.subsurface, widgetSurface.x,
+                                       widgetSurface.y);
+            widgetSurface.committedX = widgetSurface.x;
+            widgetSurface.committedY = widgetSurface.y;
+            isMoved = true;
+        }
+    }
+    for (auto &widgetSurface : m_widgetSurfaces) {
+        if (!widgetSurface.pendingBuffer) {
+            continue;
+        }
+        const auto &drawn = widgetSurface.drawn;
+        wl_surface_attach(widgetSurface.surface, widgetSurface.pendingBuffer, 0, 0);
+        drawn.buffer->OnAttached();
+        widgetSurface.pendingBuffer = nullptr;
+        for (const auto &rect : drawn.damage) {
+            wl_surface_damage_buffer(widgetSurface.surface, rect.x, rect.y, rect.cx, rect.cy);
+        }
+        // Pace by the first widget when the panel surface is not committed
+        if (!isPanelCommitted && !isMoved && !m_frameCallback) {
+            m_frameCallback = wl_surface_frame(widgetSurface.surface);
+            wl_callback_add_listener(m_frameCallback, &frame_listener, this);
+        }
+        wl_surface_commit(widgetSurface.surface);
+    }
+    return isMoved;
+}
+
+void ShellSurface::Commit() {
+    const bool isPanelCommitted = m_pendingBuffer != nullptr;
+    const bool isMoved = !m_widgetSurfaces.empty() && CommitSubsurfaces(isPanelCommitted);
+    if (!isPanelCommitted && !isMoved) {
+        // Only subsurfaces changed
+        return;
+    }
+    if (m_pendingBuffer) {
+        spdlog::trace("Draw buffer: {}x{}, {} damaged rects", m_drawn.size.cx, m_drawn.size.cy,
+                      m_drawn.damage.size());
+        // Only the region of the panel is shown from an atlas
+        int x = 0, y = 0;
+        if (m_viewport) {
+            x = m_atlasRect.x;
+            y = m_atlasRect.y;
+            if (m_viewportRect != m_atlasRect) {
+                wp_viewport_set_source(m_viewport, wl_fixed_from_int(x), wl_fixed_from_int(y),
+                                       wl_fixed_from_int(m_atlasRect.cx),
+                                       wl_fixed_from_int(m_atlasRect.cy));
+                wp_viewport_set_destination(m_viewport, m_atlasRect.cx, m_atlasRect.cy);
+                m_viewportRect = m_atlasRect;
+            }
+        }
+        wl_surface_attach(m_surface, m_pendingBuffer, 0, 0);
+        m_drawn.buffer->OnAttached();
+        m_pendingBuffer = nullptr;
+        for (const auto &rect : m_drawn.damage) {
+            wl_surface_damage_buffer(m_surface, x + rect.x, y + rect.y, rect.cx, rect.cy);
+        }
+    }
+    // Next draw is done when compositor is ready for a new frame
+    if (!m_frameCallback) {
+        m_frameCallback = wl_surface_frame(m_surface);
+        wl_callback_add_listener(m_frameCallback, &frame_listener, this);
+    }
     // Commit changes
     wl_surface_commit(m_surface);
-    registry.FlushAndDispatchCommands();
-    m_previousDamage = size;
-}
-
-void ShellSurface::Hide(const Registry &registry) {
-    if (!m_layer) return;
-    zwlr_layer_surface_v1_destroy(m_layer);
-    wl_surface_attach(m_surface, NULL, 0, 0);
-    m_layer = nullptr;
-    wl_region_destroy(m_inputRegion);
-    m_inputRegion = nullptr;
-    registry.FlushAndDispatchCommands();
+}
+
+void ShellSurface::Hide(const Registry &registry, bool keepFrame) {
+    // Frame callbacks are not invoked for hidden surfaces
+    m_needsDraw = false;
+    if (m_frameCallback) {
+        wl_callback_destroy(m_frameCallback);
+        m_frameCallback = nullptr;
+    }
+    // Never attached, give it back to the pool
+    if (m_pendingBuffer) {
+        m_drawn.buffer->Unlock();
+        m_pendingBuffer = nullptr;
+    }
+    for (auto &widgetSurface : m_widgetSurfaces) {
+        if (widgetSurface.pendingBuffer) {
+            widgetSurface.drawn.buffer->Unlock();
+            widgetSurface.pendingBuffer = nullptr;
+        }
+    }
+    if (keepFrame) {
+        // Last frame is still in the buffer, submit it again when shown. Buffers shared from
+        // another surface or drawn as part of an atlas might be redrawn by their owner.
+        m_isRasterized = m_drawn.buffer != nullptr && m_bufferPool->Owns(m_drawn.buffer);
+    } else {
+        // Hidden most of the time, no need to keep the memory
+        m_isRasterized = false;
+        m_bufferPool->Purge();
+        for (auto &widgetSurface : m_widgetSurfaces) {
+            widgetSurface.bufferPool->Purge();
+        }
+    }
+    if (!m_layer || m_isHidden) return;
+    m_isHidden = true;
+    if (!m_isConfigured) {
+        // Nothing has been attached yet
+        return;
+    }
+    // The layer surface is kept, destroying it or attaching a null buffer would require a new
+    // initial commit and configure when shown again. Instead shrink it to a transparent pixel
+    // that does not take any input. Subsurfaces are unmapped, they would be visible outside of
+    // the pixel.
+    for (auto &widgetSurface : m_widgetSurfaces) {
+        wl_surface_attach(widgetSurface.surface, nullptr, 0, 0);
+        wl_surface_commit(widgetSurface.surface);
+    }
+    zwlr_layer_surface_v1_set_size(m_layer, 1, 1);
+    wl_surface_set_input_region(m_surface, m_emptyRegion);
+    if (m_viewport) {
+        // Show all of the pixel
+        const auto unset = wl_fixed_from_int(-1);
+        wp_viewport_set_source(m_viewport, unset, unset, unset, unset);
+        wp_viewport_set_destination(m_viewport, -1, -1);
+        m_viewportRect = Rect{-1, -1, -1, -1};
+    }
+    wl_surface_attach(m_surface, registry.hiddenBuffer->Lock(), 0, 0);
+    registry.hiddenBuffer->OnAttached();
+    wl_surface_damage_buffer(m_surface, 0, 0, 1, 1);
+    wl_surface_commit(m_surface);
 }
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <spdlog/logger.h>
+#include <viewporter.h>
 #include <wayland-client-protocol.h>
 #include <wlr-layer-shell-unstable-v1.h>
 
@@ -8,6 +9,7 @@
 
 #include "zen/Configuration.h"
 #include "zen/Draw.h"
+#include "zen/HitGrid.h"
 
 class Registry;
 
@@ -15,31 +17,157 @@ class ShellSurface {
    public:
     static std::unique_ptr<ShellSurface> Create(const Registry &registry, wl_output *output,
                                                 PanelConfig panelConfiguration);
-    void Draw(const Registry &registry, BufferPool &bufferPool, const std::string &outputName);
-    void Hide(const Registry &registry);
+    // Drawing is done in three steps: Render, Raster and Submit. Only Raster may be done on
+    // another thread than main. Raster gets buffers and draws into their memory, all Wayland
+    // requests including creating and resizing the shm pools and buffers are made in Submit.
+    //
+    // Draws are paced by frame callbacks, when a frame is in flight the draw is deferred until
+    // the compositor is done with the previous frame. Draws are also deferred when the compositor
+    // holds all buffers, until a buffer is released. The deferred draw uses the state at that
+    // time. Returns true if the surface should be rasterized and submitted.
+    // Widgets that are not dirty are not rendered, repainted or damaged unless they moved.
+    //
+    // A rasterized frame is kept until submitted, when nothing has changed when the surface is
+    // drawn again the kept frame is submitted without rendering or rasterizing.
+    bool Render(const std::string &outputName, const std::vector<bool> &dirtyWidgets);
+    void Raster();
+    void Submit(const Registry &registry);
+    bool HasRasterizedFrame() const { return m_isRasterized; }
+    // Surfaces of the same panel with equal render hashes draws the same. Instead of
+    // rasterizing, one of them can share what the other has rasterized.
+    size_t RenderHash() const;
+    void Share(const ShellSurface &other);
+    // Keeping the frame makes it possible to show the surface again without rendering, otherwise
+    // the memory of the buffers is released.
+    void Hide(const Registry &registry, bool keepFrame);
+    bool HasDeferredDraw() const { return m_needsDraw && IsReadyForFrame() && !IsExhausted(); }
+    // True until the changes of the last draw are committed, also when not ready for a frame
+    bool HasPendingDraw() const { return m_needsDraw; }
+
+    // Instead of buffers of its own the surface shows a region of an atlas buffer that is shared
+    // by all panels of the output. Rasterizing is done by the output: Layout computes the size
+    // of the panel and RasterAtlas draws it in the region that the output assigned to it.
+    void UseAtlas(const Registry &registry, BufferPool *atlasPool);
+    bool NeedsRaster() const { return m_needsRaster; }
+    Size Layout();
+    // Null atlas means that there was no atlas buffer to draw in
+    void RasterAtlas(std::shared_ptr<Buffer> atlas, const Rect &region);
 
     void OnShellConfigure(uint32_t cx, uint32_t cy);
     void OnClosed();
+    void OnFrameDone();
 
     bool ClickSurface(wl_surface *surface, int x, int y);
     bool WheelSurface(wl_surface *surface, int x, int y, int value);
+    // Tracks the widget and tag under the pointer, targets styled for hover are redrawn when it
+    // changes. Null surface or a surface of another panel means that the pointer is not over
+    // this panel.
+    bool HoverSurface(wl_surface *surface, int x, int y);
 
    private:
-    ShellSurface(wl_output *output, wl_surface *surface, PanelConfig panelConfiguration)
+    static constexpr size_t none = SIZE_MAX;
+
+    // Subsurface of a single widget, the panel surface is transparent and only sized to cover
+    // the widgets when the panel draws widgets in subsurfaces.
+    struct WidgetSurface {
+        wl_surface *surface;
+        wl_subsurface *subsurface;
+        std::unique_ptr<BufferPool> bufferPool;
+        DrawnPanel drawn;
+        // Frame that the widget was drawn in
+        uint64_t frame;
+        // Position within the panel, set on the subsurface when committed
+        int x;
+        int y;
+        int committedX;
+        int committedY;
+        bool needsCommit;
+        wl_buffer *pendingBuffer;
+    };
+
+    void Commit();
+    bool RasterSubsurfaces();
+    // Returns true if the panel surface needs to be committed to apply the positions
+    bool CommitSubsurfaces(bool isPanelCommitted);
+    bool IsExhausted() const;
+    // Translates coordinates in any surface of the panel to panel coordinates, returns false if
+    // the surface does not belong to the panel.
+    bool ToPanelCoordinates(wl_surface *surface, int &x, int &y) const;
+    // Finds the widget and the tag of the target at x, y in surface. Widget is none when there is
+    // no widget there. Returns false if the surface does not belong to the panel.
+    bool FindTarget(wl_surface *surface, int x, int y, size_t &widget, std::string &tag);
+    void LogBufferStats(const std::string_view message) const;
+    // Not ready when previous frame is in flight or when waiting for initial configure
+    bool IsReadyForFrame() const { return !m_frameCallback && (!m_layer || m_isConfigured); }
+
+    ShellSurface(wl_output *output, wl_surface *surface, std::unique_ptr<BufferPool> bufferPool,
+                 PanelConfig panelConfiguration)
         : m_output(output),
           m_surface(surface),
+          m_bufferPool(std::move(bufferPool)),
           m_layer(nullptr),
           m_inputRegion(nullptr),
+          m_emptyRegion(nullptr),
+          m_inputSize{},
+          m_frameCallback(nullptr),
+          m_pendingBuffer(nullptr),
+          m_isConfigured(false),
           m_isClosed(false),
-          m_previousDamage{},
-          m_panelConfig(std::move(panelConfiguration)) {}
+          m_isHidden(false),
+          m_atlasPool(nullptr),
+          m_viewport(nullptr),
+          m_atlasRect{},
+          m_viewportRect{-1, -1, -1, -1},
+          m_needsDraw(false),
+          m_isRasterized(false),
+          m_needsRaster(false),
+          m_frame(0),
+          m_panelConfig(std::move(panelConfiguration)),
+          m_changedAt(m_panelConfig.widgets.size(), 1),
+          m_isPanelChanged(false),
+          m_isHitGridStale(true),
+          m_hoveredWidget(none) {}
 
     wl_output *m_output;
     wl_surface *m_surface;
+    std::unique_ptr<BufferPool> m_bufferPool;
     zwlr_layer_surface_v1 *m_layer;
     wl_region *m_inputRegion;
+    wl_region *m_emptyRegion;
+    // Size of layer surface and input region when shown
+    Size m_inputSize;
+    wl_callback *m_frameCallback;
+    wl_buffer *m_pendingBuffer;  // Drawn but not yet committed
+    bool m_isConfigured;
     bool m_isClosed;
-    Size m_previousDamage;
+    // Shows a transparent pixel
+    bool m_isHidden;
+    // Set when using an atlas
+    BufferPool *m_atlasPool;
+    wp_viewport *m_viewport;
+    // Region of atlas where the panel was drawn and region shown by the viewport
+    Rect m_atlasRect;
+    Rect m_viewportRect;
+    // Position of widgets as computed by Layout
+    std::vector<Rect> m_rects;
+    bool m_needsDraw;
+    bool m_isRasterized;
+    bool m_needsRaster;
+    // Number of last drawn frame
+    uint64_t m_frame;
     PanelConfig m_panelConfig;
+    // Frame number where each widget changed
+    std::vector<uint64_t> m_changedAt;
+    // Render trees of widgets, kept until a widget changes
+    std::vector<Widget> m_widgets;
     DrawnPanel m_drawn;
+    // One per widget when drawing widgets in subsurfaces, otherwise empty
+    std::vector<WidgetSurface> m_widgetSurfaces;
+    // Panel surface has a new buffer that is not committed
+    bool m_isPanelChanged;
+    // Built from the drawn panel when needed after it changed
+    HitGrid m_hitGrid;
+    bool m_isHitGridStale;
+    size_t m_hoveredWidget;
+    std::string m_hoveredTag;
 };
@@ -14,17 +14,15 @@ class DateSource : public Source {
     DateSource() : Source() {}
 };
 
-class TimeSource : public Source, public IoHandler {
+class TimeSource : public Source, public TimerHandler {
    public:
     static std::shared_ptr<TimeSource> Create(MainLoop& mainLoop,
                                               std::shared_ptr<DateSource> dateSource);
-    virtual ~TimeSource();
-    virtual bool OnRead() override;
+    virtual ~TimeSource() {}
+    virtual bool OnTimeout() override;
     void Publish(const std::string_view, ScriptContext&) override {}
 
    private:
-    TimeSource(int fd, std::shared_ptr<DateSource> dateSource)
-        : Source(), m_fd(fd), m_dateSource(dateSource) {}
-    int m_fd;
+    TimeSource(std::shared_ptr<DateSource> dateSource) : Source(), m_dateSource(dateSource) {}
     std::shared_ptr<DateSource> m_dateSource;
 };
@@ -0,0 +1,26 @@
+#include "zen/Sources/HistorySource.h"
+
+#include <spdlog/spdlog.h>
+
+using namespace std::chrono_literals;
+
+std::shared_ptr<HistorySource> HistorySource::Create(MainLoop& mainLoop) {
+    auto source = std::shared_ptr<HistorySource>(new HistorySource());
+    // Little slack, samples should be evenly spaced
+    mainLoop.RegisterTimer("HistorySource", 1s, 1s, 50ms, source);
+    return source;
+}
+
+bool HistorySource::OnTimeout() {
+    spdlog::trace("History source sampling");
+    // Sampled when sources are published
+    m_published = false;
+    m_drawn = false;
+    return true;
+}
+
+void HistorySource::Publish(const std::string_view, ScriptContext& scriptContext) {
+    if (m_published) return;
+    scriptContext.SampleHistories();
+    m_published = true;
+}
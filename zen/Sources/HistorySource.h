@@ -0,0 +1,18 @@
+#pragma once
+
+#include "zen/MainLoop.h"
+#include "zen/Sources/Sources.h"
+
+// Samples the histories of published numbers every second. Widgets that plot a history list this
+// source to be rendered with every new sample.
+class HistorySource : public Source, public TimerHandler {
+   public:
+    static std::shared_ptr<HistorySource> Create(MainLoop& mainLoop);
+    virtual ~HistorySource() {}
+    virtual bool OnTimeout() override;
+    void Publish(const std::string_view sourceName, ScriptContext& scriptContext) override;
+
+   private:
+    // Nothing to sample until the first timeout
+    HistorySource() : Source() { m_published = true; }
+};
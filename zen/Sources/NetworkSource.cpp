@@ -7,9 +7,11 @@
 #include <netinet/in.h>
 #include <sys/ioctl.h>
 #include <sys/socket.h>
-#include <sys/timerfd.h>
 
 #include "spdlog/spdlog.h"
+#include "zen/Timers.h"
+
+using namespace std::chrono_literals;
 
 // Inspired by github.com/ajrisi/lsif
 //
@@ -35,20 +37,11 @@ std::shared_ptr<NetworkSource> NetworkSource::Create(std::shared_ptr<MainLoop> m
     if (sock < 0) {
         return nullptr;
     }
-    auto fd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC | TFD_NONBLOCK);
-    if (fd == -1) {
-        spdlog::error("Failed to create timer: {}", strerror(errno));
-        return nullptr;
-    }
-    itimerspec timer = {.it_interval = {.tv_sec = 30, .tv_nsec = 0},
-                        .it_value = {.tv_sec = 1, .tv_nsec = 0}};
-    auto ret = timerfd_settime(fd, 0, &timer, nullptr);
-    if (ret == -1) {
-        spdlog::error("Failed to set timer: {}", strerror(errno));
-        return nullptr;
-    }
-    auto source = std::shared_ptr<NetworkSource>(new NetworkSource(mainloop, sock, fd));
-    mainloop->RegisterIoHandler(fd, "NetworkSource", source);
+    auto source = std::shared_ptr<NetworkSource>(new NetworkSource(mainloop, sock));
+    // Initial state is read on initialize. Poll on the same half minutes as other sources and
+    // allow some delay to be coalesced with other timers.
+    auto initial = Timers::UntilWallClockMultipleOf(30s);
+    mainloop->RegisterTimer("NetworkSource", initial, 30s, 10s, source);
     return source;
 }
 
@@ -131,14 +124,8 @@ void NetworkSource::ReadState() {
     }
 }
 
-bool NetworkSource::OnRead() {
+bool NetworkSource::OnTimeout() {
     spdlog::info("Check network");
-    uint64_t ignore;
-    auto n = read(m_timerfd, &ignore, sizeof(ignore));
-    if (n <= 0) {
-        // Either block or no events
-        return false;
-    }
     ReadState();
     return !m_published;
 }
@@ -6,22 +6,21 @@
 #include "zen/ScriptContext.h"
 #include "zen/Sources/Sources.h"
 
-class NetworkSource : public Source, public IoHandler {
+class NetworkSource : public Source, public TimerHandler {
    public:
     static std::shared_ptr<NetworkSource> Create(std::shared_ptr<MainLoop> mainloop);
     void Initialize();
-    virtual bool OnRead() override;
+    virtual bool OnTimeout() override;
     void Publish(const std::string_view sourceName, ScriptContext& scriptContext) override;
-    virtual ~NetworkSource() { close(m_timerfd); }
+    virtual ~NetworkSource() { close(m_socket); }
 
    private:
-    NetworkSource(std::shared_ptr<MainLoop> mainloop, int socket, int timerfd)
-        : Source(), m_mainloop(mainloop), m_socket(socket), m_timerfd(timerfd) {}
+    NetworkSource(std::shared_ptr<MainLoop> mainloop, int socket)
+        : Source(), m_mainloop(mainloop), m_socket(socket) {}
     void ReadState();
 
     std::shared_ptr<MainLoop> m_mainloop;
     int m_socket;
-    int m_timerfd;
     std::shared_ptr<ScriptContext> m_scriptContext;
     Networks m_networks;
 };
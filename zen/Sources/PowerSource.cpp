@@ -2,28 +2,21 @@
 
 #include <fcntl.h>
 #include <spdlog/spdlog.h>
-#include <sys/timerfd.h>
 
 #include <filesystem>
 #include <optional>
 #include <string>
 
+#include "zen/Timers.h"
+
+using namespace std::chrono_literals;
+
 std::shared_ptr<PowerSource> PowerSource::Create(std::shared_ptr<MainLoop> mainloop) {
-    // Use non blocking to make sure we never hang on read
-    auto fd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC | TFD_NONBLOCK);
-    if (fd == -1) {
-        spdlog::error("Failed to create timer: {}", strerror(errno));
-        return nullptr;
-    }
-    itimerspec timer = {.it_interval = {.tv_sec = 30, .tv_nsec = 0},
-                        .it_value = {.tv_sec = 1, .tv_nsec = 0}};
-    auto ret = timerfd_settime(fd, 0, &timer, nullptr);
-    if (ret == -1) {
-        spdlog::error("Failed to set timer: {}", strerror(errno));
-        return nullptr;
-    }
-    auto source = std::shared_ptr<PowerSource>(new PowerSource(mainloop, fd));
-    mainloop->RegisterIoHandler(fd, "PowerSource", source);
+    auto source = std::shared_ptr<PowerSource>(new PowerSource(mainloop));
+    // Initial state is read on initialize. Poll on the same half minutes as other sources, battery
+    // state is not that urgent so it can be delayed to be coalesced with other timers.
+    auto initial = Timers::UntilWallClockMultipleOf(30s);
+    mainloop->RegisterTimer("PowerSource", initial, 30s, 10s, source);
     return source;
 }
 
@@ -115,16 +108,8 @@ void PowerSource::ReadState() {
     }
 }
 
-PowerSource::~PowerSource() { close(m_timerfd); }
-
-bool PowerSource::OnRead() {
+bool PowerSource::OnTimeout() {
     spdlog::debug("Polling power status");
-    uint64_t ignore;
-    auto n = read(m_timerfd, &ignore, sizeof(ignore));
-    if (n <= 0) {
-        // Either block or no events
-        return false;
-    }
     ReadState();
     return !m_published;
 }
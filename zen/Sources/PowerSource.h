@@ -6,22 +6,20 @@
 #include "zen/ScriptContext.h"
 #include "zen/Sources/Sources.h"
 
-class PowerSource : public Source, public IoHandler {
+class PowerSource : public Source, public TimerHandler {
    public:
     static std::shared_ptr<PowerSource> Create(std::shared_ptr<MainLoop> mainloop);
     bool Initialize();
     void ReadState();
-    virtual bool OnRead() override;
+    virtual bool OnTimeout() override;
     void Publish(const std::string_view sourceName, ScriptContext& scriptContext) override;
-    virtual ~PowerSource();
+    virtual ~PowerSource() {}
 
    private:
-    PowerSource(std::shared_ptr<MainLoop> mainloop, int fd)
-        : Source(), m_mainloop(mainloop), m_timerfd(fd) {}
+    PowerSource(std::shared_ptr<MainLoop> mainloop) : Source(), m_mainloop(mainloop) {}
     std::shared_ptr<MainLoop> m_mainloop;
     std::filesystem::path m_batteryCapacity;
     std::filesystem::path m_batteryStatus;
     std::filesystem::path m_ac;
-    int m_timerfd;
     PowerState m_sourceState;
 };
@@ -0,0 +1,117 @@
+#include "zen/Timers.h"
+
+#include <spdlog/spdlog.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstring>
+
+using std::chrono::milliseconds;
+
+std::shared_ptr<Timers> Timers::Create() {
+    // Use non blocking to make sure we never hang on read
+    auto fd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC | TFD_NONBLOCK);
+    if (fd == -1) {
+        spdlog::error("Failed to create timer: {}", strerror(errno));
+        return nullptr;
+    }
+    return std::shared_ptr<Timers>(new Timers(fd));
+}
+
+Timers::~Timers() { close(m_fd); }
+
+int Timers::Add(const std::string_view name, milliseconds initial, milliseconds period,
+                milliseconds slack, std::shared_ptr<TimerHandler> handler) {
+    auto id = m_nextId++;
+    m_timers.push_back(Timer{.id = id,
+                             .name = std::string(name),
+                             .deadline = Clock::now() + initial,
+                             .period = period,
+                             .slack = slack,
+                             .handler = handler});
+    spdlog::debug("Adding timer {} with period {}ms and slack {}ms", name, period.count(),
+                  slack.count());
+    Arm();
+    return id;
+}
+
+void Timers::Remove(int id) {
+    std::erase_if(m_timers, [id](const auto& timer) { return timer.id == id; });
+    Arm();
+}
+
+void Timers::Arm() {
+    // Wake up at the latest point that is within the slack of every timer, this
+    // drags timers that are due a bit earlier along to the same wakeup.
+    auto wakeup = Clock::time_point::max();
+    for (const auto& timer : m_timers) {
+        wakeup = std::min(wakeup, timer.deadline + timer.slack);
+    }
+    if (wakeup == m_armed) {
+        return;
+    }
+    m_armed = wakeup;
+    itimerspec spec{};
+    if (wakeup != Clock::time_point::max()) {
+        auto sinceEpoch = wakeup.time_since_epoch();
+        auto seconds = std::chrono::duration_cast<std::chrono::seconds>(sinceEpoch);
+        auto nanoseconds =
+            std::chrono::duration_cast<std::chrono::nanoseconds>(sinceEpoch - seconds);
+        spec.it_value = {.tv_sec = seconds.count(), .tv_nsec = nanoseconds.count()};
+        // Zero means disarm
+        if (spec.it_value.tv_sec == 0 && spec.it_value.tv_nsec == 0) {
+            spec.it_value.tv_nsec = 1;
+        }
+    }
+    if (timerfd_settime(m_fd, TFD_TIMER_ABSTIME, &spec, nullptr) == -1) {
+        spdlog::error("Failed to set timer: {}", strerror(errno));
+    }
+}
+
+bool Timers::OnRead() {
+    uint64_t ignore;
+    auto n = read(m_fd, &ignore, sizeof(ignore));
+    if (n <= 0) {
+        // Either block or no events
+        return false;
+    }
+    // Collect first, handlers are allowed to add and remove timers
+    const auto now = Clock::now();
+    std::vector<int> due;
+    for (auto& timer : m_timers) {
+        if (timer.deadline <= now) {
+            due.push_back(timer.id);
+            // Reschedule relative to deadline to avoid drift
+            timer.deadline += timer.period;
+            if (timer.deadline <= now) {
+                timer.deadline = now + timer.period;
+            }
+        }
+    }
+    spdlog::trace("{} timers due", due.size());
+    bool anyDirty = false;
+    for (auto id : due) {
+        auto it = std::find_if(m_timers.begin(), m_timers.end(),
+                               [id](const auto& timer) { return timer.id == id; });
+        if (it == m_timers.end()) {
+            continue;
+        }
+        // Handler might remove timer
+        auto handler = it->handler;
+        spdlog::trace("Invoking timer {}", it->name);
+        anyDirty = handler->OnTimeout() || anyDirty;
+    }
+    // Make sure that timer is armed again even if nothing changed
+    m_armed = Clock::time_point::min();
+    Arm();
+    return anyDirty;
+}
+
+milliseconds Timers::UntilWallClockMultipleOf(std::chrono::seconds period) {
+    using std::chrono::system_clock;
+    auto sinceEpoch =
+        std::chrono::duration_cast<milliseconds>(system_clock::now().time_since_epoch());
+    auto rest = sinceEpoch % period;
+    return period - rest;
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <chrono>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "zen/MainLoop.h"
+
+// All timers in the main loop share one timerfd. Each timer has a slack that tells how
+// much a timeout is allowed to be delayed, timers that are due within the slack of each
+// other are fired in the same wakeup and thus in the same batch of changes.
+class Timers : public IoHandler {
+   public:
+    static std::shared_ptr<Timers> Create();
+    virtual ~Timers();
+
+    int Fd() const { return m_fd; }
+    // Periodic timer, first timeout after initial and then every period.
+    int Add(const std::string_view name, std::chrono::milliseconds initial,
+            std::chrono::milliseconds period, std::chrono::milliseconds slack,
+            std::shared_ptr<TimerHandler> handler);
+    void Remove(int id);
+
+    virtual bool OnRead() override;
+
+    // Time until wall clock is at next multiple of period, useful for aligning timers
+    // that should fire on whole minutes and so on.
+    static std::chrono::milliseconds UntilWallClockMultipleOf(std::chrono::seconds period);
+
+   private:
+    using Clock = std::chrono::steady_clock;
+    struct Timer {
+        int id;
+        std::string name;
+        Clock::time_point deadline;
+        std::chrono::milliseconds period;
+        std::chrono::milliseconds slack;
+        std::shared_ptr<TimerHandler> handler;
+    };
+
+    Timers(int fd) : m_fd(fd), m_nextId(1), m_armed{} {}
+    void Arm();
+
+    int m_fd;
+    int m_nextId;
+    Clock::time_point m_armed;
+    // Few timers, kept unordered
+    std::vector<Timer> m_timers;
+};
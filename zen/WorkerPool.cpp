@@ -0,0 +1,74 @@
+#include "zen/WorkerPool.h"
+
+#include <spdlog/spdlog.h>
+
+std::unique_ptr<WorkerPool> WorkerPool::Create(int numThreads, Task init) {
+    auto pool = std::unique_ptr<WorkerPool>(new WorkerPool());
+    for (int i = 0; i < numThreads; i++) {
+        pool->m_threads.emplace_back(&WorkerPool::Work, pool.get(), init);
+    }
+    spdlog::debug("Created worker pool with {} threads", numThreads);
+    return pool;
+}
+
+WorkerPool::~WorkerPool() {
+    {
+        std::lock_guard lock(m_mutex);
+        m_isStopping = true;
+    }
+    m_started.notify_all();
+    for (auto &thread : m_threads) {
+        thread.join();
+    }
+}
+
+void WorkerPool::RunTasks(std::unique_lock<std::mutex> &lock) {
+    while (m_tasks && m_next < m_tasks->size()) {
+        auto &task = (*m_tasks)[m_next++];
+        lock.unlock();
+        task();
+        lock.lock();
+        m_numDone++;
+        if (m_numDone == m_tasks->size()) {
+            m_done.notify_all();
+        }
+    }
+}
+
+void WorkerPool::Work(const Task &init) {
+    // Batches are run by the other threads meanwhile
+    if (init) {
+        init();
+    }
+    std::unique_lock lock(m_mutex);
+    for (;;) {
+        m_started.wait(lock, [this] {
+            return m_isStopping || (m_tasks && m_next < m_tasks->size());
+        });
+        if (m_isStopping) {
+            return;
+        }
+        RunTasks(lock);
+    }
+}
+
+void WorkerPool::Run(std::vector<Task> &tasks) {
+    if (tasks.empty()) {
+        return;
+    }
+    // Not worth waking up any threads
+    if (tasks.size() == 1 || m_threads.empty()) {
+        for (auto &task : tasks) {
+            task();
+        }
+        return;
+    }
+    std::unique_lock lock(m_mutex);
+    m_tasks = &tasks;
+    m_next = 0;
+    m_numDone = 0;
+    m_started.notify_all();
+    RunTasks(lock);
+    m_done.wait(lock, [this] { return m_numDone == m_tasks->size(); });
+    m_tasks = nullptr;
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Threads that runs batches of independent tasks. The calling thread takes part in running the
+// tasks and the call returns when all tasks in the batch are done.
+class WorkerPool {
+   public:
+    using Task = std::function<void()>;
+
+    // Each thread runs init once when started, before it takes part in any batch
+    static std::unique_ptr<WorkerPool> Create(int numThreads, Task init = nullptr);
+    virtual ~WorkerPool();
+
+    void Run(std::vector<Task> &tasks);
+
+   private:
+    WorkerPool() : m_tasks(nullptr), m_next(0), m_numDone(0), m_isStopping(false) {}
+    void Work(const Task &init);
+    // Runs tasks in current batch until there are no more to pick, returns when lock is held.
+    void RunTasks(std::unique_lock<std::mutex> &lock);
+
+    std::vector<std::thread> m_threads;
+    std::mutex m_mutex;
+    std::condition_variable m_started;
+    std::condition_variable m_done;
+    // Current batch
+    std::vector<Task> *m_tasks;
+    size_t m_next;
+    size_t m_numDone;
+    bool m_isStopping;
+};
@@ -5,10 +5,12 @@
 #include <optional>
 
 #include "zen/Compositors/Sway/SwayCompositor.h"
+#include "zen/FontWarmup.h"
 #include "zen/MainLoop.h"
 #include "zen/Manager.h"
 #include "zen/Registry.h"
 #include "zen/Sources/DateTimeSources.h"
+#include "zen/Sources/HistorySource.h"
 #include "zen/Sources/NetworkSource.h"
 #include "zen/Sources/PowerSource.h"
 #include "zen/Sources/PulseAudio/PulseAudioSource.h"
@@ -52,6 +54,10 @@ static void InitializeSource(const std::string& source, Sources& sources,
         sources.Register("time", timeSource);
         return;
     }
+    if (source == "history") {
+        sources.Register(source, HistorySource::Create(*mainLoop));
+        return;
+    }
     if (source == "displays") {
         // Initialized by manager later..
         return;
@@ -126,6 +132,8 @@ int main(int argc, char* argv[]) {
         spdlog::error("Failed to read configuration");
         return -1;
     }
+    // Load fonts while connecting to Wayland and Sway
+    auto fontWarmup = FontWarmup::Start(config->fonts);
     std::shared_ptr<MainLoop> mainLoop = MainLoop::Create();
     if (!mainLoop) {
         spdlog::error("Failed to initialize main loop");
@@ -155,7 +163,7 @@ int main(int argc, char* argv[]) {
         }
     }
     // Manager handles displays and redrawing
-    std::shared_ptr<Manager> manager = Manager::Create(registry);
+    std::shared_ptr<Manager> manager = Manager::Create(registry, *mainLoop, config->prerender);
     // Initialize compositor
     switch (config->displays.compositor) {
         case Compositor::Sway: {
@@ -179,6 +187,8 @@ int main(int argc, char* argv[]) {
     }
     // Make sure that an initial state of all sources are published
     sources->PublishAll();
+    // Nothing is drawn before the main loop runs
+    fontWarmup->Finish();
     // Let over control to mainloop and manager
     manager->SetSources(std::move(sources));
     sources = nullptr;